@@ -0,0 +1,60 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hyprload::build {
+    // Stands in for getPluginProfilesPath() in toolchain flags, so build keys do not depend
+    // on where the profiles live. Expanded when the flags are exported
+    const std::string c_profilesPlaceholder = "{profiles}";
+
+    // Compiler and flags from a [toolchains.<name>] table of hyprload.toml, exported to the
+    // builds of the plugins using it
+    struct SToolchain {
+        std::string m_sCC;
+        std::string m_sCXX;
+        std::string m_sCFlags;
+        std::string m_sCXXFlags;
+        std::string m_sLDFlags;
+        // Build instrumented first, then optimized with the profile collected while loaded
+        bool m_bPgo = false;
+    };
+
+    // CC, CXX, CFLAGS, CXXFLAGS and LDFLAGS, leaving out the ones the toolchain does not set,
+    // with the placeholders expanded
+    std::vector<std::pair<std::string, std::string>>
+    getToolchainVariables(const SToolchain& toolchain);
+    // Identifies the output of the toolchain, including the host CPU with -march=native
+    std::string getToolchainHash(const SToolchain& toolchain);
+
+    // The toolchain of each plugin, set on the main thread before its build starts and read
+    // by the workers building and installing it
+    void setPluginToolchain(const std::string& plugin, const std::optional<SToolchain>& toolchain);
+    std::optional<SToolchain> getPluginToolchain(const std::string& plugin);
+
+    struct SBuildEnvironment {
+        // The complete environment of the build, nothing else is inherited
+        std::vector<std::pair<std::string, std::string>> m_vVariables;
+        // Covers everything that shapes the output, but not the host-specific paths the
+        // prefix maps hide, so every machine building the same revision agrees on it
+        std::string m_sHash;
+    };
+
+    // An allowlisted environment with a fixed locale and timezone, SOURCE_DATE_EPOCH set to
+    // the source's commit time, and the source and headers paths mapped out of the output.
+    // The toolchain's flags go after the prefix maps. The hash also covers the --version of
+    // the compilers the environment resolves
+    SBuildEnvironment makeHermeticEnvironment(const std::filesystem::path& sourcePath,
+                                              const std::filesystem::path& hyprlandHeadersPath,
+                                              const std::optional<SToolchain>& toolchain);
+
+    // command, run by sh with exactly the variables of environment
+    std::string wrapCommand(const SBuildEnvironment& environment, const std::string& command);
+
+    std::string shellQuote(const std::string& value);
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "HyprloadPlugin.hpp"
+#include "Pipeline.hpp"
 
 namespace hyprload {
     class BuildProcessDescriptor final {
@@ -17,7 +18,8 @@ namespace hyprload {
         std::filesystem::path m_sHyprlandHeadersPath;
 
         std::mutex m_mMutex;
-        std::optional<hyprload::Result<std::monostate, std::string>> m_rResult;
+        pipeline::eStage m_eStage;
+        std::optional<hyprload::Result<pipeline::eOutcome, std::string>> m_rResult;
     };
 
 }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <string>
+#include <variant>
+
+namespace hyprload::compression {
+    const std::string c_extension = ".zst";
+
+    // Where binary is stored when binaries are kept compressed
+    std::filesystem::path getCompressedPath(const std::filesystem::path& binary);
+    bool isCompressed(const std::filesystem::path& path);
+
+    hyprload::Result<std::monostate, std::string> compressFile(const std::filesystem::path& source,
+                                                               const std::filesystem::path& target);
+
+    // Decompress into an anonymous memory file, so the uncompressed binary never touches the
+    // disk. The caller owns the returned descriptor, and must keep it open while the binary is
+    // loaded, or a later memory file could reuse its path
+    hyprload::Result<fd_t, std::string> decompressToMemory(const std::filesystem::path& source);
+    // Where memory files cannot be mapped executable, decompress into a fresh directory under
+    // directory instead, removed along with the file. The file is only accessible to the user
+    hyprload::Result<std::filesystem::path, std::string>
+    decompressToFile(const std::filesystem::path& source, const std::filesystem::path& directory);
+    // Whether the dynamic linker can map the memory file, vm.memfd_noexec can strip its exec bits
+    bool isExecutable(fd_t fd);
+    // A path the dynamic linker can open the memory file by
+    std::filesystem::path getMemoryFilePath(fd_t fd);
+    bool isMemoryFilePath(const std::filesystem::path& path);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace hyprload::elf {
+    // Section and note owner hyprload stamps into installed binaries
+    const std::string c_noteSection = ".note.hyprload";
+    const std::string c_noteOwner = "hyprload";
+    constexpr u32 c_noteTypeHeadersCommit = 1;
+
+    struct SElfInfo {
+        std::optional<std::string> m_sHeadersCommit;
+        std::vector<std::string> m_vNeeded;
+        // DT_RUNPATH, or DT_RPATH without one, split into its directories
+        std::vector<std::string> m_vRunPaths;
+        std::vector<std::string> m_vUndefinedSymbols;
+    };
+
+    // Reads the dynamic section, dynamic symbols and hyprload note of a shared object
+    hyprload::Result<SElfInfo, std::string> scanElf(const std::filesystem::path& path);
+
+    // Checks a scanned binary against the running compositor: headers commit, libraries and
+    // every non-weak undefined symbol must resolve, otherwise loading would fail or crash
+    hyprload::Result<std::monostate, std::string>
+    checkCompatibility(const SElfInfo& info, const std::optional<std::string>& runningCommit);
+
+    // Writes a note file recording the headers commit, suitable for objcopy --add-section
+    hyprload::Result<std::monostate, std::string>
+    writeHeadersNote(const std::filesystem::path& notePath, const std::string& headersCommit);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace hyprload::gc {
+    enum class eGcEntryKind {
+        SOURCE,
+        HEADERS,
+        CACHE,
+    };
+
+    struct SGcEntry {
+        std::filesystem::path m_pPath;
+        eGcEntryKind m_eKind;
+        usize m_iSize;
+        std::filesystem::file_time_type m_tLastUsed;
+    };
+
+    struct SGcStats {
+        usize m_iBytesFreed = 0;
+        usize m_iBytesRemaining = 0;
+        usize m_iEntriesRemoved = 0;
+    };
+
+    class GarbageCollector final {
+      public:
+        // maxSize of 0 evicts every unreferenced entry, otherwise entries are evicted
+        // least-recently-used first until the hyprload directories fit into maxSize bytes
+        GarbageCollector(std::vector<std::filesystem::path>&& referencedSources,
+                         std::vector<std::string>&& requiredPlugins,
+                         std::filesystem::path&& headersInUse, usize maxSize);
+
+        void collect();
+
+        std::mutex m_mMutex;
+        std::optional<hyprload::Result<SGcStats, std::string>> m_rResult;
+
+      private:
+        std::vector<SGcEntry> findCandidates();
+        bool isReferencedSource(const std::filesystem::path& path) const;
+
+        std::vector<std::filesystem::path> m_vReferencedSources;
+        std::vector<std::string> m_vRequiredPlugins;
+        std::filesystem::path m_pHeadersInUse;
+        usize m_iMaxSize;
+    };
+}
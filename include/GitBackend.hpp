@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace hyprload::git {
+    enum class eBranchStatus {
+        UP_TO_DATE,
+        BEHIND,
+        AHEAD,
+        DIVERGED,
+    };
+
+    struct SProgress {
+        usize m_iReceivedObjects = 0;
+        usize m_iTotalObjects = 0;
+        usize m_iReceivedBytes = 0;
+    };
+
+    typedef std::function<void(const SProgress&)> ProgressCallback;
+
+    class GitBackend {
+      public:
+        virtual ~GitBackend() = default;
+
+        // An empty branch clones the remote's default branch. depth 0 clones full history
+        virtual hyprload::Result<std::monostate, std::string>
+        clone(const std::string& url, const std::string& branch, const std::filesystem::path& path,
+              usize depth, bool recurseSubmodules, const ProgressCallback& progress) = 0;
+
+        // Fetch origin, updating the remote-tracking branches. There is no depth on purpose,
+        // in a shallow clone a plain fetch already only transfers the commits since its
+        // shallow tip. Cutting the new commits at a depth instead would leave them unconnected
+        // to HEAD, which fastForward() then sees as diverged
+        virtual hyprload::Result<std::monostate, std::string>
+        fetch(const std::filesystem::path& path, const ProgressCallback& progress) = 0;
+
+        // Move the current branch to its upstream, refusing anything but a fast-forward
+        virtual hyprload::Result<std::monostate, std::string>
+        fastForward(const std::filesystem::path& path) = 0;
+
+        // Detach HEAD at commit, updating submodules to match when asked
+        virtual hyprload::Result<std::monostate, std::string>
+        checkout(const std::filesystem::path& path, const std::string& commit,
+                 bool recurseSubmodules) = 0;
+
+        // Current branch against its upstream, as of the last fetch
+        virtual hyprload::Result<eBranchStatus, std::string>
+        getBranchStatus(const std::filesystem::path& path) = 0;
+
+        virtual std::optional<std::string> getHead(const std::filesystem::path& path) = 0;
+
+        // Committer time of HEAD, in seconds since the epoch
+        virtual std::optional<i64> getCommitTime(const std::filesystem::path& path) = 0;
+
+        // The commit a remote ref points at, without fetching anything
+        virtual std::optional<std::string> lsRemote(const std::string& url,
+                                                    const std::string& ref) = 0;
+    };
+
+    // libgit2 when hyprload was built with it, the git CLI otherwise
+    GitBackend& getBackend();
+
+    // Reports transfer progress as debug notifications, in steps of a quarter
+    ProgressCallback makeProgressReporter(const std::string& what);
+}
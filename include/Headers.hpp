@@ -0,0 +1,28 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <string>
+
+namespace hyprload::headers {
+    // Generate only what plugins compile against: protocol headers from the Makefile's
+    // wayland-scanner rules, wlroots' configured headers and version.h. Generated files are
+    // cached by a hash of their inputs, so unchanged protocols are reused across commits
+    hyprload::Result<std::monostate, std::string> generateHeaders(const std::filesystem::path& tree);
+
+    // Clone, check out and prepare a Hyprland tree in place, so plugins can build against it.
+    // Falls back to `make pluginenv` when generateHeaders() is disabled or fails
+    hyprload::Result<std::monostate, std::string> prepareTree(const std::filesystem::path& tree,
+                                                              const std::string& commit);
+
+    // Bring the per-user headers tree to commit. Holds the tree's lock, so another instance
+    // preparing the same commit is waited for and reused
+    hyprload::Result<std::monostate, std::string>
+    setupLocalHeaders(const std::filesystem::path& tree, const std::string& commit);
+
+    // Prepare <sharedCache>/headers/<commit> unless someone already published it. The tree is
+    // prepared under a temporary name and renamed into place once complete
+    hyprload::Result<std::monostate, std::string>
+    setupSharedHeaders(const std::filesystem::path& sharedCache, const std::string& commit);
+}
@@ -4,23 +4,66 @@
 
 #include "HyprloadPlugin.hpp"
 #include "HyprloadOverlay.hpp"
+#include "BuildEnvironment.hpp"
 #include "BuildProcessDescriptor.hpp"
-
+#include "GarbageCollector.hpp"
+#include "Maintenance.hpp"
+#include "Pipeline.hpp"
+#include "Preloader.hpp"
+#include "UpdateChecker.hpp"
+
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <variant>
 #include <string>
+#include <thread>
 #include <vector>
 #include <optional>
 #include <filesystem>
-#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include <src/helpers/Color.hpp>
 #include <src/helpers/Monitor.hpp>
 #include <src/render/Texture.hpp>
 
+class CPlugin;
+
 namespace hyprload {
     void tryCleanupPreviousSessions();
+    void tryCleanupPreviousSessions(const std::filesystem::path& sessionsPath);
+
+    // An install or update requested while another run was busy. Requests of the same kind
+    // are merged, so any number of them leads to at most one follow-up install and update
+    struct SQueuedRun {
+        bool m_bUpdate = false;
+        bool m_bAllPlugins = false;
+        std::unordered_set<std::string> m_sPlugins;
+    };
+
+    // A plugin marked lazy, which stays unloaded behind stub dispatchers until one is called
+    struct SLazyPlugin {
+        std::vector<std::string> m_vDispatchers;
+        usize m_iIdleUnload = 0;
+        // The session copy loaded on first use
+        std::filesystem::path m_pPath;
+        bool m_bStubbed = false;
+        std::chrono::steady_clock::time_point m_tLastUse;
+        // The plugin's own handlers behind the wrappers updating m_tLastUse, which expire once
+        // the plugin unloads and its dispatchers are removed
+        std::vector<std::pair<std::string, std::weak_ptr<std::function<void(std::string)>>>>
+            m_vHandlers;
+    };
+
+    // A stub dispatcher call, forwarded from handleTick() once the plugin is loaded
+    struct SLazyDispatch {
+        std::string m_sPlugin;
+        std::string m_sDispatcher;
+        std::string m_sArgs;
+    };
 
     class Hyprload final {
       public:
@@ -28,11 +71,27 @@ namespace hyprload {
 
         void handleTick();
 
-        void installPlugins();
-        void updatePlugins();
+        // Without a name every required plugin is processed. While a run is in progress,
+        // requests it already covers are dropped and the rest are queued behind it
+        void installPlugins(const std::optional<std::string>& name = std::nullopt);
+        void updatePlugins(const std::optional<std::string>& name = std::nullopt);
 
         void loadPlugins();
         void reloadPlugins();
+        // Swap a single plugin for its freshly installed binary, leaving the others loaded
+        hyprload::Result<std::monostate, std::string> reloadPlugin(const std::string& name);
+
+        // Load only the plugins of a profile from hyprload.toml, or every installed plugin
+        // without a name. Only the difference to the loaded set is unloaded and loaded, and
+        // later loads and reloads keep to the profile
+        void switchProfile(const std::optional<std::string>& name);
+
+        // Evict unreferenced sources, header trees and caches on a background thread.
+        // Automatic runs only happen with a configured size budget, and stop once under it
+        void collectGarbage(bool automatic);
+
+        // Report the result of the last background update check
+        void showUpdateStatus();
 
         bool lockSession();
         void unlockSession();
@@ -40,7 +99,7 @@ namespace hyprload {
         // Unload all plugins, except *this* plugin
         void clearPlugins();
 
-        // Cleanup specific to *this* plugin
+        // Cleanup specific to *this* plugin, waiting for its background threads
         void cleanupPlugin();
 
         const std::vector<std::string>& getLoadedPlugins() const;
@@ -49,14 +108,138 @@ namespace hyprload {
       private:
         std::optional<std::filesystem::path> getSessionBinariesPath();
         std::string generateSessionGuid();
+        // Drop the session's binaries and lock, once every plugin is unloaded
+        void endSession();
+        // Run job on thread, which must have finished its previous job. Background threads
+        // run code of *this* plugin, so cleanupPlugin() joins them instead of detaching them
+        void startThread(std::thread& thread, std::function<void()>&& job);
         void setupHeaders();
+        void requestRun(bool update, const std::optional<std::string>& name);
+        bool isCoveredByCurrentRun(bool update, const std::string& name) const;
+        // Start the queued update, then the queued install, skipping runs that select nothing.
+        // False when none started
+        bool startQueuedRun();
+        // Whether run selected anything to start
+        bool runPipelines(const SQueuedRun& run);
+        // The reload and garbage collection owed once the last run is over
+        void finishRuns();
+        std::shared_ptr<const pipeline::Pipeline> createPipeline(bool update, bool load);
+        // Start a background check of every source's remote once the interval has passed,
+        // but only while nothing else runs, the machine is idle and on AC
+        void scheduleUpdateCheck();
+        // Start background git maintenance of the repositories that are due, under the
+        // same conditions as update checks
+        void scheduleMaintenance();
+        // Anything running that background work should not compete with
+        bool isBusy() const;
+
+        // Load and unload through the plugin system directly, instead of formatting hyprctl
+        // commands and parsing their replies
+        hyprload::Result<std::monostate, std::string>
+        preflightCheck(const std::filesystem::path& path);
+        // The same check, safe to run off the main thread
+        preload::PreflightCheck getPreflightCheck();
+        hyprload::Result<CPlugin*, std::string> loadPlugin(const std::filesystem::path& path);
+        hyprload::Result<std::monostate, std::string> unloadPlugin(CPlugin* plugin);
+        std::unordered_map<std::string, CPlugin*> getLoadedPluginsByPath() const;
+        // Whether the binary named plugin, e.g. hyprbars.so, belongs to the active profile
+        bool isInActiveProfile(const std::string& plugin) const;
+        // In the active profile, and not power hungry while those are unloaded
+        bool shouldLoad(const std::string& plugin) const;
+        // Unload the loaded plugins that shouldLoad() rejects and load the installed ones it
+        // accepts, returning how many were unloaded and loaded
+        std::pair<usize, usize> syncLoadedPlugins();
+        void applyPowerPolicy();
+        usize getBuildSlots() const;
+
+        // The binary the plugin named name is installed as, e.g. hyprbars.so
+        std::string getBinaryName(const std::string& name) const;
+        const plugin::PluginRequirement* findRequirement(const std::string& plugin) const;
+        // The toolchain requirement is built with. Unknown toolchains are reported when report
+        // is set
+        std::optional<build::SToolchain>
+        resolveToolchain(const plugin::PluginRequirement& requirement, bool report) const;
+        // Register stub dispatchers in place of loading plugin, if it is lazy and its binary
+        // declares dispatchers. Otherwise it has to be loaded right away
+        bool stubLazyPlugin(const std::string& plugin, const std::filesystem::path& path);
+        void addLazyStubs(const std::string& plugin);
+        void removeLazyStubs(const std::string& plugin);
+        hyprload::Result<std::monostate, std::string> loadLazyPlugin(const std::string& plugin);
+        // Calls no longer pass through the stubs once loaded, so wrap the plugin's handlers
+        void trackLazyDispatchers(const std::string& plugin);
+        void runLazyDispatches();
+        // Load the binaries the preloader has mapped so far, in the order they were staged
+        void loadPreloadedPlugins();
+        // Hand a compressed binary to the running preloader, or to a new one
+        void queuePreload(preload::SPreloadRequest&& request);
+        // Swap the loaded or stubbed plugin for the checked binary at pluginPath, keeping the
+        // previous binary if the new one fails to load
+        hyprload::Result<std::monostate, std::string>
+        swapPlugin(const std::string& plugin, const std::filesystem::path& pluginPath);
+        // Rebuild the plugins preflight refused, once the preloader is done adding to them
+        void rebuildRefusedPlugins();
+        // Decompressed binaries are loaded from memory files, which stay open as long as their
+        // path is staged, loaded or stubbed
+        std::filesystem::path trackMemoryFile(fd_t fd);
+        // Close the memory file behind path, false if path is a regular file instead
+        bool releaseMemoryFile(const std::filesystem::path& path);
+        // Release a staged binary, memory file or copy, along with its swap directory
+        void discardStagedBinary(const std::filesystem::path& path);
+        void unloadIdlePlugins();
+        // Drop the stubs and hand the plugin's own handlers back, before *this* plugin unloads
+        void releaseLazyPlugins();
+        // Once an instrumented plugin was loaded for the collection time, unload it to write
+        // out its profile and install it again, which rebuilds it optimized and reloads it
+        void collectProfiles();
 
         std::vector<std::string> m_vPlugins;
+        std::unordered_map<std::string, std::filesystem::path> m_mPluginPaths;
+        usize m_iSwapGeneration = 0;
+        usize m_iStreamedReloads = 0;
         std::optional<std::string> m_sSessionGuid;
         std::optional<flock_t> m_iSessionLock;
+        std::optional<std::string> m_sActiveProfile;
+        std::optional<std::unordered_set<std::string>> m_sProfilePlugins;
+        bool m_bBuildsDeferred = false;
+        bool m_bPowerHungryUnloaded = false;
+        std::unordered_map<std::string, SLazyPlugin> m_mLazyPlugins;
+        std::vector<SLazyDispatch> m_vLazyDispatches;
+        std::shared_ptr<preload::Preloader> m_pPreloader;
+        // The preloader holds the initial load of the session
+        bool m_bLoadingPlugins = false;
+        // Staged plugins waiting on the preloader, dropped when something else loads them first
+        std::unordered_map<std::string, std::filesystem::path> m_mPreloading;
+        std::unordered_map<std::string, fd_t> m_mMemoryFiles;
+        std::vector<std::string> m_vRefusedPlugins;
+        // When each instrumented plugin was first seen loaded since the last run
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+            m_mProfileCollections;
+        // Instrumented plugins that wrote no profile or failed to build with it, which are not
+        // unloaded again
+        std::unordered_set<std::string> m_sFailedCollections;
+        // Plugins unloaded for their optimized build, until its run reports back
+        std::unordered_set<std::string> m_sProfileRebuilds;
+        std::chrono::steady_clock::time_point m_tNextProfileCheck;
 
         bool m_bIsBuilding = false;
+        bool m_bCurrentRunIsUpdate = false;
+        bool m_bReloadQueued = false;
+        std::unordered_set<std::string> m_sCurrentRunPlugins;
+        std::optional<SQueuedRun> m_sQueuedUpdate;
+        std::optional<SQueuedRun> m_sQueuedInstall;
+        bool m_bPreflightRebuildScheduled = false;
         std::vector<std::shared_ptr<BuildProcessDescriptor>> m_vBuildProcesses;
+
+        std::thread m_tHeadersThread;
+        std::thread m_tGarbageCollectorThread;
+        std::thread m_tUpdateCheckThread;
+        std::thread m_tMaintenanceThread;
+
+        std::shared_ptr<gc::GarbageCollector> m_pGarbageCollector;
+        std::shared_ptr<updates::UpdateCheck> m_pUpdateCheck;
+        std::chrono::steady_clock::time_point m_tNextUpdateCheck;
+        std::shared_ptr<maintenance::RepositoryMaintenance> m_pMaintenance;
+        std::chrono::steady_clock::time_point m_tNextMaintenance;
     };
 
     inline std::unique_ptr<Hyprload> g_pHyprload;
@@ -1,10 +1,12 @@
 #pragma once
 #include "globals.hpp"
 #include "toml/toml.hpp"
+#include "BuildEnvironment.hpp"
 #include "HyprloadPlugin.hpp"
 
 #include <string>
 #include <filesystem>
+#include <optional>
 #include <variant>
 #include <vector>
 
@@ -20,6 +22,10 @@ namespace hyprload::config {
         void reloadConfig();
         const toml::table& getConfig() const;
         const std::vector<hyprload::plugin::PluginRequirement>& getPlugins() const;
+        // The plugin names of [profiles.<name>], if that profile exists
+        std::optional<std::vector<std::string>> getProfile(const std::string& name) const;
+        // The compiler and flags of [toolchains.<name>], if that toolchain exists
+        std::optional<hyprload::build::SToolchain> getToolchain(const std::string& name) const;
 
       private:
         void parseConfig();
@@ -4,6 +4,7 @@
 #include "types.hpp"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <filesystem>
 #include <variant>
@@ -21,6 +22,8 @@ namespace hyprload::plugin {
 
         const std::filesystem::path& getBinaryOutputPath() const;
         const std::vector<std::string>& getBuildSteps() const;
+        // The dispatchers the plugin registers, which lazy loading stubs until the first call
+        const std::vector<std::string>& getDispatchers() const;
 
       private:
         std::string m_sName;
@@ -30,6 +33,7 @@ namespace hyprload::plugin {
 
         std::filesystem::path m_pBinaryOutputPath;
         std::vector<std::string> m_sBuildSteps;
+        std::vector<std::string> m_sDispatchers;
     };
 
     class HyprloadManifest {
@@ -51,12 +55,26 @@ namespace hyprload::plugin {
         virtual bool isUpToDate() = 0;
         virtual bool providesPlugin(const std::string& name) const = 0;
 
+        // The checked out revision, and the one the remote has now. Unversioned sources have
+        // neither
+        virtual std::optional<std::string> getRevision();
+        virtual std::optional<std::string> getRemoteRevision();
+        // The file name deploy() installs the binary of name as
+        virtual std::string getBinaryName(const std::string& name) const;
+
+        // Bring an installed source up to date, without building anything
+        [[nodiscard]] virtual hyprload::Result<std::monostate, std::string> pullSource() = 0;
+        // pullSource(), then install()
         [[nodiscard]] virtual hyprload::Result<std::monostate, std::string>
         update(const std::string& name, const std::filesystem::path& hyprlandHeaders) = 0;
         [[nodiscard]] virtual hyprload::Result<std::monostate, std::string>
         build(const std::string& name, const std::filesystem::path& hyprlandHeaders) = 0;
+        // build(), then deploy()
         [[nodiscard]] virtual hyprload::Result<std::monostate, std::string>
         install(const std::string& name, const std::filesystem::path& hyprlandHeaders) = 0;
+        // Copy an already built binary into the plugin binaries directory
+        [[nodiscard]] virtual hyprload::Result<std::monostate, std::string>
+        deploy(const std::string& name, const std::filesystem::path& hyprlandHeaders) = 0;
 
         bool operator==(const PluginSource& other) const;
 
@@ -72,18 +90,29 @@ namespace hyprload::plugin {
         bool isSourceAvailable() override;
         bool isUpToDate() override;
         bool providesPlugin(const std::string& name) const override;
+        std::optional<std::string> getRevision() override;
+        std::optional<std::string> getRemoteRevision() override;
+        std::string getBinaryName(const std::string& name) const override;
 
+        hyprload::Result<std::monostate, std::string> pullSource() override;
         hyprload::Result<std::monostate, std::string>
         update(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         build(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         install(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
+        hyprload::Result<std::monostate, std::string>
+        deploy(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
+
+        const std::filesystem::path& getSourcePath() const;
 
       protected:
         bool isEquivalent(const PluginSource& other) const override;
 
       private:
+        // Identifies a build of name in the shared cache, across users and their source paths
+        std::string getArtifactKey(const std::string& name, const std::string& buildKey) const;
+
         std::string m_sUrl;
         std::string m_sBranch;
         std::filesystem::path m_pSourcePath;
@@ -97,13 +126,17 @@ namespace hyprload::plugin {
         bool isSourceAvailable() override;
         bool isUpToDate() override;
         bool providesPlugin(const std::string& name) const override;
+        std::string getBinaryName(const std::string& name) const override;
 
+        hyprload::Result<std::monostate, std::string> pullSource() override;
         hyprload::Result<std::monostate, std::string>
         update(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         build(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         install(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
+        hyprload::Result<std::monostate, std::string>
+        deploy(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
 
       protected:
         bool isEquivalent(const PluginSource& other) const override;
@@ -120,13 +153,18 @@ namespace hyprload::plugin {
         bool isSourceAvailable() override;
         bool isUpToDate() override;
         bool providesPlugin(const std::string& name) const override;
+        std::optional<std::string> getRevision() override;
+        std::optional<std::string> getRemoteRevision() override;
 
+        hyprload::Result<std::monostate, std::string> pullSource() override;
         hyprload::Result<std::monostate, std::string>
         update(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         build(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
         hyprload::Result<std::monostate, std::string>
         install(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
+        hyprload::Result<std::monostate, std::string>
+        deploy(const std::string& name, const std::filesystem::path& hyprlandHeaders) override;
 
       protected:
         bool isEquivalent(const PluginSource& other) const override;
@@ -143,12 +181,43 @@ namespace hyprload::plugin {
         std::shared_ptr<PluginSource> getSource() const;
 
         bool isInstalled() const;
+        // Marked power_hungry, so it may be unloaded while on battery
+        bool isPowerHungry() const;
+        // Marked lazy, so it is only loaded once one of its dispatchers is called
+        bool isLazy() const;
+        // Seconds without a dispatcher call before a lazy plugin is unloaded again, 0 to keep
+        // it loaded
+        usize getIdleUnload() const;
+        // The [toolchains.<name>] to build it with, instead of the default toolchain
+        const std::optional<std::string>& getToolchain() const;
 
       private:
         std::string m_sName;
         std::shared_ptr<PluginSource> m_pSource;
         std::filesystem::path m_pBinaryPath;
+        bool m_bPowerHungry = false;
+        bool m_bLazy = false;
+        usize m_iIdleUnload = 0;
+        std::optional<std::string> m_sToolchain = std::nullopt;
     };
 
+    // binary itself, or its compressed copy when binaries are stored compressed
+    std::optional<std::filesystem::path> findInstalledBinary(const std::filesystem::path& binary);
+
+    // The dispatchers the manifest declared for an installed binary, recorded at deploy time
+    // so lazy plugins can be stubbed without reading their sources
+    std::vector<std::string> getInstalledDispatchers(const std::filesystem::path& installedBinary);
+
+    // Drop the build key of an installed binary, so the next install rebuilds it even though
+    // its revision and headers commit are unchanged
+    void forgetInstalledBuild(const std::filesystem::path& installedBinary);
+
+    // Remove installed binaries, their debug info and profiles, of plugins not in
+    // requiredPlugins. Returns the bytes freed
+    usize removeUnrequiredBinaries(const std::vector<std::string>& requiredPlugins);
+
+    // Sources pulled since are not pulled again, e.g. for each plugin they provide
+    void startRun();
+
     inline std::vector<std::shared_ptr<PluginSource>> g_vPluginSources;
 }
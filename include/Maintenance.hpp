@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace hyprload::maintenance {
+    struct SRepository {
+        std::filesystem::path m_pPath;
+        // Prefix of the lock guarding the checkout, see getPathLockFile()
+        std::string m_sLockPrefix;
+        bool m_bSharedLock = false;
+    };
+
+    struct SMaintenanceStats {
+        usize m_iMaintained = 0;
+        usize m_iSkipped = 0;
+        bool m_bTimedOut = false;
+    };
+
+    // Repositories hyprload manages that were not maintained within interval seconds,
+    // least recently maintained first
+    std::vector<SRepository> findDueRepositories(usize interval);
+
+    // Runs git maintenance tasks over the repositories at idle priority on a background
+    // thread, like the garbage collector, stopping once timeLimit seconds are spent
+    class RepositoryMaintenance final {
+      public:
+        RepositoryMaintenance(std::vector<SRepository>&& repositories, usize timeLimit);
+
+        void run();
+
+        std::mutex m_mMutex;
+        std::optional<hyprload::Result<SMaintenanceStats, std::string>> m_rResult;
+
+      private:
+        std::vector<SRepository> m_vRepositories;
+        usize m_iTimeLimit;
+    };
+}
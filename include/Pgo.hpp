@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.hpp"
+#include "BuildEnvironment.hpp"
+
+#include <filesystem>
+#include <string>
+#include <variant>
+
+namespace hyprload::pgo {
+    // Plugins with a pgo toolchain are first built instrumented, and once their profile is
+    // collected, rebuilt optimized with it. A new source revision starts over, since the
+    // counters no longer match its code
+    enum class ePhase {
+        GENERATE,
+        USE,
+    };
+
+    // Where the instrumented binary of plugin writes its .gcda or .profraw files
+    std::filesystem::path getProfilePath(const std::string& plugin);
+    // USE once a profile of the revision checked out at sourcePath was collected
+    ePhase getPhase(const std::string& plugin, const std::filesystem::path& sourcePath);
+
+    // toolchain with the flags of phase added. The profile path goes into the flags as
+    // build::c_profilesPlaceholder, so the build key does not depend on it
+    build::SToolchain applyPhase(const std::string& plugin, ePhase phase,
+                                 const build::SToolchain& toolchain);
+
+    // Clears stale counters before an instrumented build, and merges clang's raw profiles
+    // before an optimized one
+    hyprload::Result<std::monostate, std::string> prepareBuild(const std::string& plugin,
+                                                               ePhase phase);
+    // Records what the build produced. An instrumented binary is collected from once loaded,
+    // and a collected profile only counts once the optimized build succeeded with it. A
+    // failed optimized build drops the profile, so the instrumented binary collects again
+    void finishBuild(const std::string& plugin, const std::filesystem::path& sourcePath,
+                     ePhase phase, bool success);
+
+    // The installed binary is instrumented and its profile not collected yet
+    bool isCollecting(const std::string& plugin);
+    // Counters are only written out once the instrumented binary unloads
+    bool hasProfileData(const std::string& plugin);
+    // Build plugin optimized with its profile on the next install
+    void requestOptimizedBuild(const std::string& plugin);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace hyprload {
+    class BuildProcessDescriptor;
+}
+
+namespace hyprload::pipeline {
+    enum class eStage {
+        RESOLVE,
+        FETCH,
+        WAIT_HEADERS,
+        BUILD,
+        INSTALL,
+        LOAD,
+        // Of a compressed binary about to be loaded, outside of any run
+        DECOMPRESS,
+    };
+
+    // Each stage declares what it occupies, and the executor never runs more stages of a
+    // class at once than that class has slots
+    enum class eResource {
+        NONE,
+        NETWORK,
+        CPU,
+        // CPU work a plugin load waits on. Never paused along with builds, so plugins still
+        // load on battery
+        LOADING,
+        // Runs from handleTick() instead of a worker, slots are per tick
+        MAIN_THREAD,
+    };
+
+    enum class eStageFlow {
+        NEXT,
+        // Not ready yet, park the job until Executor::wake()
+        PENDING,
+        // Nothing left to do, finish the job early
+        UP_TO_DATE,
+    };
+
+    enum class eOutcome {
+        UPDATED,
+        UP_TO_DATE,
+    };
+
+    typedef hyprload::Result<eStageFlow, std::string> StageResult;
+    typedef std::function<StageResult(BuildProcessDescriptor&)> StageFunction;
+
+    std::string getStageName(eStage stage);
+
+    struct SStage {
+        eStage m_eStage;
+        eResource m_eResource;
+        StageFunction m_fnRun;
+    };
+
+    class Pipeline final {
+      public:
+        Pipeline& addStage(eStage stage, eResource resource, StageFunction&& run);
+
+        const std::vector<SStage>& getStages() const;
+
+      private:
+        std::vector<SStage> m_vStages;
+    };
+
+    class Executor final {
+      public:
+        Executor();
+        ~Executor();
+
+        void setResourceLimit(eResource resource, usize limit);
+        // Stages of a paused resource wait in the queue, the ones already running finish
+        void setResourcePaused(eResource resource, bool paused);
+
+        // Runs the pipeline's stages for the descriptor one after another, storing the
+        // outcome in the descriptor once the last stage finishes or any stage fails
+        void submit(std::shared_ptr<const Pipeline> pipeline,
+                    std::shared_ptr<BuildProcessDescriptor> descriptor);
+
+        // Run job on a worker once resource has a free slot, as a single stage job of its own
+        void post(eStage stage, eResource resource, std::string&& name,
+                  std::function<void()>&& job);
+
+        // Retry every job parked by a PENDING stage
+        void wake();
+
+        void runMainThreadTasks();
+
+      private:
+        struct STask {
+            std::shared_ptr<const Pipeline> m_pPipeline;
+            std::shared_ptr<BuildProcessDescriptor> m_pDescriptor;
+            usize m_iStage;
+        };
+
+        // Shared with the workers, which the destructor stops and joins
+        struct SState {
+            std::mutex m_mMutex;
+            std::condition_variable m_cvWork;
+            std::deque<STask> m_dQueue;
+            std::deque<STask> m_dMainThreadQueue;
+            std::vector<STask> m_vParked;
+            std::unordered_map<eResource, usize> m_mLimits;
+            std::unordered_map<eResource, usize> m_mInUse;
+            std::unordered_map<eResource, bool> m_mPaused;
+            usize m_iWorkers = 0;
+            usize m_iWakeGeneration = 0;
+            bool m_bStopping = false;
+        };
+
+        static void workerLoop(std::shared_ptr<SState> state);
+        static void runTask(const std::shared_ptr<SState>& state, STask&& task);
+        static void enqueue(const std::shared_ptr<SState>& state, STask&& task);
+        static bool isRunnable(SState& state, const STask& task);
+
+        void ensureWorkers();
+
+        std::shared_ptr<SState> m_pState;
+        // Their code is in *this* plugin, so none may outlive it
+        std::vector<std::thread> m_vWorkers;
+    };
+
+    inline std::unique_ptr<Executor> g_pExecutor;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace hyprload::power {
+    struct SPowerState {
+        bool m_bOnAc = true;
+        std::optional<f64> m_fTemperature;
+    };
+
+    // Decides what hyprload may do given the power supply and temperature, as configured
+    class PowerPolicy final {
+      public:
+        // Re-reads the power supplies and thermal zones every few seconds. True if any
+        // decision below changed since the last poll
+        bool poll();
+
+        // Builds queued or waiting to start stay parked, fetches continue
+        bool shouldDeferBuilds() const;
+        // Build one plugin at a time
+        bool shouldLimitBuilds() const;
+        bool shouldUnloadPowerHungry() const;
+
+        const SPowerState& getState() const;
+
+      private:
+        bool isAbove(usize threshold, bool wasAbove) const;
+
+        SPowerState m_sState;
+        bool m_bDeferBuilds = false;
+        bool m_bLimitBuilds = false;
+        bool m_bUnloadPowerHungry = false;
+        std::chrono::steady_clock::time_point m_tNextPoll;
+    };
+
+    inline std::unique_ptr<PowerPolicy> g_pPowerPolicy;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace hyprload::preload {
+    struct SPreloadRequest {
+        std::string m_sPlugin;
+        // The staged binary, or the installed compressed one
+        std::filesystem::path m_pPath;
+        // Lazy plugins are only decompressed and checked, their constructors wait for the
+        // first dispatcher call
+        bool m_bOpen = true;
+        // Swapped for the loaded plugin once ready, instead of loaded next to it
+        bool m_bReload = false;
+    };
+
+    struct SPreloaded {
+        std::string m_sPlugin;
+        // The path it was requested under, the compressed binary for compressed ones
+        std::filesystem::path m_pStagedPath;
+        std::filesystem::path m_pPath;
+        // Keeps the object resident and relocated until the compositor has loaded it too,
+        // nullptr if dlopen failed and the compositor's load should report why
+        void* m_pHandle = nullptr;
+        // The memory file a compressed binary was decompressed into, which the main thread
+        // takes over
+        std::optional<fd_t> m_iMemoryFile = std::nullopt;
+        // Decompressed into a file of its own instead, where memory files cannot be mapped
+        // executable. Removed along with its directory unless the main thread takes it over
+        bool m_bDecompressedFile = false;
+        std::optional<std::string> m_sError = std::nullopt;
+        // m_sError comes from the preflight check refusing the binary
+        bool m_bRefused = false;
+        bool m_bReload = false;
+    };
+
+    typedef std::function<hyprload::Result<std::monostate, std::string>(
+        const std::filesystem::path&)>
+        PreflightCheck;
+
+    // dlopens staged binaries on a background thread, so the dynamic linker maps and
+    // relocates them there. The compositor's own dlopen of the same path then only takes
+    // another reference, leaving just PLUGIN_INIT on the main thread. Static constructors
+    // of the plugins run on this thread as well. Compressed binaries are decompressed in
+    // parallel as executor jobs, checked with the preflight check, and opened there too
+    class Preloader final : public std::enable_shared_from_this<Preloader> {
+      public:
+        // Decompressed files go in fresh directories under stagingPath
+        Preloader(std::vector<SPreloadRequest>&& plugins, PreflightCheck&& preflightCheck,
+                  const std::filesystem::path& stagingPath);
+        ~Preloader();
+
+        // Opens the staged binaries in order on the preloader's own thread, which cancel()
+        // and the destructor join, and queues the compressed ones
+        void start();
+        // Queue another compressed binary, from the main thread
+        void add(SPreloadRequest&& request);
+        // Stop opening binaries, close the ones not taken yet, and wait for the thread, so
+        // nothing runs on it once the plugin unloads. Jobs still running release their
+        // binary once they see the cancel
+        void cancel();
+
+        std::mutex m_mMutex;
+        // In the order they became ready, waiting for handleTick() to load them and release
+        // the handles
+        std::vector<SPreloaded> m_vReady;
+        // Nothing is left running or queued
+        bool m_bDone = false;
+
+      private:
+        void run();
+        void decompress(const SPreloadRequest& request);
+        // Replace the memory file of preloaded with a decompressed file, and open that
+        void decompressToFile(const SPreloadRequest& request, SPreloaded& preloaded);
+        // Hand over preloaded, or release it if cancelled meanwhile
+        void finish(SPreloaded&& preloaded);
+
+        std::vector<SPreloadRequest> m_vPlugins;
+        PreflightCheck m_fnPreflightCheck;
+        std::filesystem::path m_pStagingPath;
+        usize m_iPending = 0;
+        bool m_bCancelled = false;
+        std::thread m_tThread;
+    };
+
+    // Drops the handle, and the memory file or decompressed file unless it was taken
+    void release(const SPreloaded& preloaded);
+}
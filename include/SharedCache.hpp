@@ -0,0 +1,23 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <string>
+
+namespace hyprload::cache {
+    std::filesystem::path getSharedHeadersPath(const std::filesystem::path& sharedCache,
+                                               const std::string& commit);
+    std::filesystem::path getArtifactPath(const std::filesystem::path& sharedCache,
+                                          const std::string& key, const std::string& filename);
+    std::filesystem::path getSharedLockPath(const std::filesystem::path& sharedCache,
+                                            const std::string& name);
+
+    // Group-writable and setgid, so everything created below stays usable by the whole group
+    void createSharedDirectory(const std::filesystem::path& path);
+
+    // Copy a built binary into the shared cache under key, publishing it with a single rename
+    hyprload::Result<std::monostate, std::string>
+    publishArtifact(const std::filesystem::path& sharedCache, const std::string& key,
+                    const std::filesystem::path& binary);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+namespace hyprload::system {
+    // False only when a power supply reports running on battery. Machines without any
+    // power supply information, like most desktops, count as on AC
+    bool isOnAcPower();
+
+    // The hottest thermal zone in degrees Celsius, if the kernel exposes any
+    std::optional<f64> getTemperature();
+
+    // The 1-minute load average is below a quarter of the cores
+    bool isIdle();
+
+    // The model name of the first CPU, as /proc/cpuinfo reports it
+    std::optional<std::string> getCpuModel();
+
+    // The efficiency cores of a hybrid CPU, from cpu_atom on Intel or the lower per-CPU
+    // capacities elsewhere. Nothing on CPUs where every core is the same
+    std::optional<std::vector<usize>> getEfficiencyCpus();
+
+    // Restricts the calling thread, and every process it starts, to cpus until destroyed
+    class ScopedAffinity final {
+      public:
+        ScopedAffinity(const std::vector<usize>& cpus);
+        ~ScopedAffinity();
+
+        ScopedAffinity(const ScopedAffinity&) = delete;
+        ScopedAffinity& operator=(const ScopedAffinity&) = delete;
+
+      private:
+        cpu_set_t m_sPrevious;
+        bool m_bApplied = false;
+    };
+
+    // Lowest CPU and IO priority for the calling thread and every command it starts
+    void setIdlePriority();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "types.hpp"
+#include "HyprloadPlugin.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace hyprload::updates {
+    // A source's checked out revision, and the one its remote had at m_iCheckedAt
+    struct SRevisionCheck {
+        i64 m_iCheckedAt = 0;
+        std::string m_sLocal;
+        std::string m_sRemote;
+    };
+
+    // Results of remote checks, kept in the cache directory so explicit updates and later
+    // sessions can reuse them instead of asking every remote again
+    class UpdateCache final {
+      public:
+        // The remote revision of name, if it was checked within the update check interval
+        std::optional<std::string> getFreshRemoteRevision(const std::string& name);
+
+        void recordCheck(const std::string& name, SRevisionCheck&& check);
+        // The source of name was moved to revision, e.g. by a pull
+        void recordRevision(const std::string& name, const std::string& revision);
+        // Results of a full check. Entries for plugins not in checked are dropped, the ones
+        // whose remote could not be reached are kept
+        void recordFullCheck(std::unordered_map<std::string, SRevisionCheck>&& checks,
+                             const std::unordered_set<std::string>& checked);
+
+        // Names of the plugins whose remote is ahead of their source, sorted
+        std::vector<std::string> getAvailableUpdates();
+        // Their number as of the last load or record, without touching the cache file, for
+        // the render thread
+        usize getAvailableUpdateCount();
+        // When the last full check finished, as a unix timestamp
+        std::optional<i64> getLastCheckTime();
+
+      private:
+        void load();
+        void save();
+        void countAvailableUpdates();
+
+        std::mutex m_mMutex;
+        std::atomic<usize> m_iAvailableUpdates = 0;
+        bool m_bLoaded = false;
+        std::optional<i64> m_iLastCheck;
+        std::unordered_map<std::string, SRevisionCheck> m_mChecks;
+    };
+
+    // One background pass over every source, handed to a thread like the garbage collector
+    class UpdateCheck final {
+      public:
+        UpdateCheck(
+            std::vector<std::pair<std::string, std::shared_ptr<plugin::PluginSource>>>&& sources);
+
+        void check();
+
+        std::mutex m_mMutex;
+        // The number of available updates once the check finished
+        std::optional<usize> m_iResult;
+
+      private:
+        std::vector<std::pair<std::string, std::shared_ptr<plugin::PluginSource>>> m_vSources;
+    };
+
+    inline std::unique_ptr<UpdateCache> g_pUpdateCache;
+}
@@ -14,15 +14,97 @@ namespace hyprload {
     const std::string c_hyprlandHeaders = "plugin:hyprload:hyprland_headers";
     const std::string c_pluginQuiet = "plugin:hyprload:quiet";
     const std::string c_pluginDebug = "plugin:hyprload:debug";
+    const std::string c_gcMaxSize = "plugin:hyprload:gc_max_size";
+    const std::string c_splitDebugInfo = "plugin:hyprload:split_debug_info";
+    const std::string c_preflightCheck = "plugin:hyprload:preflight_check";
+    const std::string c_streamingReload = "plugin:hyprload:streaming_reload";
+    const std::string c_networkJobs = "plugin:hyprload:network_jobs";
+    const std::string c_buildJobs = "plugin:hyprload:build_jobs";
+    const std::string c_xdgLayout = "plugin:hyprload:xdg_layout";
+    const std::string c_sharedCache = "plugin:hyprload:shared_cache";
+    const std::string c_minimalHeaders = "plugin:hyprload:minimal_headers";
+    const std::string c_headersArchive = "plugin:hyprload:headers_archive";
+    const std::string c_updateCheckInterval = "plugin:hyprload:update_check_interval";
+    const std::string c_maintenanceInterval = "plugin:hyprload:maintenance_interval";
+    const std::string c_maintenanceTimeLimit = "plugin:hyprload:maintenance_time_limit";
+    const std::string c_deferBuildsOnBattery = "plugin:hyprload:defer_builds_on_battery";
+    const std::string c_deferBuildsAbove = "plugin:hyprload:defer_builds_above";
+    const std::string c_limitBuildsAbove = "plugin:hyprload:limit_builds_above";
+    const std::string c_unloadPowerHungry = "plugin:hyprload:unload_power_hungry";
+    const std::string c_buildAffinity = "plugin:hyprload:build_affinity";
+    const std::string c_compressBinaries = "plugin:hyprload:compress_binaries";
+    const std::string c_hermeticBuilds = "plugin:hyprload:hermetic_builds";
+    const std::string c_toolchain = "plugin:hyprload:toolchain";
+    const std::string c_pgoCollectionTime = "plugin:hyprload:pgo_collection_time";
+
+    // Written into trees extracted from archives, which have no git metadata
+    const std::string c_archiveCommitFile = ".hyprload-commit";
+    // Shipped in archives, `<commit> <path>` per submodule, so extracting needs no git
+    const std::string c_archiveSubmodulesFile = ".hyprload-submodules";
 
     std::filesystem::path getRootPath();
+    // Session copies of the binaries and locks, never shared across machines. With the
+    // XDG layout this is $XDG_RUNTIME_DIR/hyprload, otherwise the root
+    std::filesystem::path getRuntimePath();
+    // Everything that can be rebuilt: sources, header trees and caches. With the XDG layout
+    // this is $XDG_CACHE_HOME/hyprload, otherwise the root
+    std::filesystem::path getCacheRootPath();
+    // What remembers past work, like update checks and maintenance runs, which the garbage
+    // collector never touches. With the XDG layout this is $XDG_STATE_HOME/hyprload,
+    // otherwise the state directory in the root
+    std::filesystem::path getStatePath();
     std::optional<std::filesystem::path> getConfigHyprlandHeadersPath();
+    // System-wide cache of header trees and built binaries, shared between users
+    std::optional<std::filesystem::path> getSharedCachePath();
+    // URL or path of a source archive, with {repo} and {commit} placeholders
+    std::optional<std::string> getHeadersArchiveTemplate();
+    std::filesystem::path getDefaultHyprlandHeadersPath();
     std::filesystem::path getHyprlandHeadersPath();
     std::filesystem::path getPluginsPath();
     std::filesystem::path getPluginBinariesPath();
+    std::filesystem::path getPluginDebugInfoPath();
+    // Profiles collected for PGO builds, kept out of the cache since collecting takes a while
+    std::filesystem::path getPluginProfilesPath();
+    std::filesystem::path getPluginSourcesPath();
+    std::filesystem::path getSelfSourcePath();
+    std::filesystem::path getSessionsPath();
+    std::filesystem::path getCachePath();
+    std::filesystem::path getLocksPath();
 
     bool isQuiet();
     bool isDebug();
+    usize getGcMaxSize();
+    bool isSplitDebugInfo();
+    bool isPreflightCheck();
+    bool isStreamingReload();
+    bool isXdgLayout();
+    bool isMinimalHeaders();
+    usize getNetworkJobs();
+    usize getBuildJobs();
+    // In seconds, 0 when background update checks are disabled
+    usize getUpdateCheckInterval();
+    // In seconds, 0 when background repository maintenance is disabled
+    usize getMaintenanceInterval();
+    usize getMaintenanceTimeLimit();
+    bool isDeferBuildsOnBattery();
+    // In degrees Celsius, 0 when disabled
+    usize getDeferBuildsTemperature();
+    usize getLimitBuildsTemperature();
+    bool isUnloadPowerHungry();
+    // efficiency, all or all_when_idle
+    std::string getBuildAffinity();
+    bool isCompressBinaries();
+    bool isHermeticBuilds();
+    // The [toolchains.<name>] used by plugins that do not pick one
+    std::optional<std::string> getDefaultToolchain();
+    // In seconds, how long instrumented binaries stay loaded before they are rebuilt optimized
+    usize getPgoCollectionTime();
+
+    // The commit of the running compositor, as reported by `hyprctl version`
+    std::optional<std::string> getHyprlandCommit();
+    // The commit checked out in a Hyprland source tree used as headers, or the commit an
+    // archive tree was extracted from
+    std::optional<std::string> getHeadersCommit(const std::filesystem::path& hyprlandHeaders);
 
     void info(const std::string& message, usize duration = 5000);
     void success(const std::string& message, usize duration = 5000);
@@ -33,5 +115,32 @@ namespace hyprload {
     std::optional<flock_t> tryGetLock(const std::filesystem::path& path);
     void releaseLock(flock_t lock);
 
+    // flock on a lock file, held until destroyed. These coordinate work on the shared
+    // directories between every hyprload instance using the same root
+    class FileLock final {
+      public:
+        FileLock(const std::filesystem::path& lockFile, bool shared = false, bool wait = true);
+        ~FileLock();
+
+        FileLock(const FileLock&) = delete;
+        FileLock& operator=(const FileLock&) = delete;
+
+        // False if the lock could not be taken without waiting, or the file not created
+        bool isLocked() const;
+
+      private:
+        fd_t m_iFd = -1;
+    };
+
+    std::filesystem::path getLockFile(const std::string& name);
+    // Stable lock file guarding a directory, e.g. a plugin source
+    std::filesystem::path getPathLockFile(const std::string& prefix,
+                                          const std::filesystem::path& path);
+
+    // 64-bit FNV-1a, as hex
+    std::string hashString(const std::string& data);
+
     std::tuple<int, std::string> executeCommand(const std::string& command);
+
+    usize getDiskUsage(const std::filesystem::path& path);
 }
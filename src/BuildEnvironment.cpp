@@ -0,0 +1,203 @@
+#include "BuildEnvironment.hpp"
+#include "GitBackend.hpp"
+#include "SystemMonitor.hpp"
+#include "util.hpp"
+
+#include <cstdlib>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+namespace hyprload::build {
+    // Needed to find and run the toolchain, but without any effect on what it produces
+    const std::vector<std::string> c_passthroughVariables = {
+        "PATH", "HOME", "USER", "TMPDIR", "PKG_CONFIG_PATH",
+    };
+
+    const std::string c_sourcePlaceholder = "{source}";
+    const std::string c_headersPlaceholder = "{headers}";
+
+    std::string replaceAll(std::string value, const std::string& from, const std::string& to) {
+        for (usize position = value.find(from); position != std::string::npos;
+             position = value.find(from, position + to.size())) {
+            value.replace(position, from.size(), to);
+        }
+
+        return value;
+    }
+
+    std::mutex g_mToolchainsMutex;
+    std::unordered_map<std::string, SToolchain> g_mPluginToolchains;
+
+    // --version output of the compilers, by the command that printed it
+    std::mutex g_mCompilerVersionsMutex;
+    std::unordered_map<std::string, std::string> g_mCompilerVersions;
+
+    std::string joinFlags(const std::string& first, const std::string& second) {
+        if (first.empty() || second.empty()) {
+            return first + second;
+        }
+
+        return first + " " + second;
+    }
+
+    // -march=native and friends make the output depend on the CPU building it
+    std::string getHostInput(const SToolchain& toolchain) {
+        for (const std::string& flags :
+             {toolchain.m_sCFlags, toolchain.m_sCXXFlags, toolchain.m_sLDFlags}) {
+            if (flags.find("=native") != std::string::npos) {
+                return "CPU=" + system::getCpuModel().value_or("unknown") + "\n";
+            }
+        }
+
+        return std::string();
+    }
+
+    // As configured, placeholders included
+    std::vector<std::pair<std::string, std::string>>
+    getPortableToolchainVariables(const SToolchain& toolchain) {
+        std::vector<std::pair<std::string, std::string>> variables = {
+            {"CC", toolchain.m_sCC},           {"CXX", toolchain.m_sCXX},
+            {"CFLAGS", toolchain.m_sCFlags},   {"CXXFLAGS", toolchain.m_sCXXFlags},
+            {"LDFLAGS", toolchain.m_sLDFlags},
+        };
+
+        std::erase_if(variables, [](const auto& variable) { return variable.second.empty(); });
+
+        return variables;
+    }
+
+    std::vector<std::pair<std::string, std::string>>
+    getToolchainVariables(const SToolchain& toolchain) {
+        std::vector<std::pair<std::string, std::string>> variables =
+            getPortableToolchainVariables(toolchain);
+
+        for (auto& [name, value] : variables) {
+            value = replaceAll(value, c_profilesPlaceholder, getPluginProfilesPath().string());
+        }
+
+        return variables;
+    }
+
+    std::string getToolchainHash(const SToolchain& toolchain) {
+        std::string hashInput = std::string();
+
+        for (const auto& [name, value] : getPortableToolchainVariables(toolchain)) {
+            hashInput += name + "=" + value + "\n";
+        }
+
+        return hashString(hashInput + getHostInput(toolchain));
+    }
+
+    void setPluginToolchain(const std::string& plugin, const std::optional<SToolchain>& toolchain) {
+        auto lock = std::scoped_lock<std::mutex>(g_mToolchainsMutex);
+
+        if (toolchain.has_value()) {
+            g_mPluginToolchains[plugin] = toolchain.value();
+        } else {
+            g_mPluginToolchains.erase(plugin);
+        }
+    }
+
+    std::optional<SToolchain> getPluginToolchain(const std::string& plugin) {
+        auto lock = std::scoped_lock<std::mutex>(g_mToolchainsMutex);
+        auto toolchain = g_mPluginToolchains.find(plugin);
+
+        if (toolchain == g_mPluginToolchains.end()) {
+            return std::nullopt;
+        }
+
+        return toolchain->second;
+    }
+
+    // The compilers a build under environment runs, as make picks them
+    std::string getCompilerVersions(const SBuildEnvironment& environment) {
+        std::string command = wrapCommand(
+            environment, "${CC:-cc} --version 2>&1; ${CXX:-c++} --version 2>&1; true");
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(g_mCompilerVersionsMutex);
+            auto versions = g_mCompilerVersions.find(command);
+
+            if (versions != g_mCompilerVersions.end()) {
+                return versions->second;
+            }
+        }
+
+        std::string versions = std::get<1>(executeCommand(command));
+
+        auto lock = std::scoped_lock<std::mutex>(g_mCompilerVersionsMutex);
+
+        g_mCompilerVersions[command] = versions;
+
+        return versions;
+    }
+
+    SBuildEnvironment makeHermeticEnvironment(const std::filesystem::path& sourcePath,
+                                              const std::filesystem::path& hyprlandHeadersPath,
+                                              const std::optional<SToolchain>& toolchain) {
+        i64 sourceDate = git::getBackend().getCommitTime(sourcePath).value_or(0);
+
+        // Embedded __FILE__ strings and DWARF paths come out the same wherever the source and
+        // headers live. -ffile-prefix-map implies -fdebug-prefix-map
+        std::string prefixMaps = "-ffile-prefix-map=" + c_sourcePlaceholder +
+            "=. -ffile-prefix-map=" + c_headersPlaceholder + "=hyprland";
+        SToolchain flags = toolchain.value_or(SToolchain());
+
+        // In the order they are exported, with placeholders for the host-specific paths
+        std::vector<std::pair<std::string, std::string>> portable = {
+            {"LANG", "C"},
+            {"LC_ALL", "C"},
+            {"TZ", "UTC"},
+            {"SOURCE_DATE_EPOCH", std::to_string(sourceDate)},
+            {"HYPRLAND_HEADERS", c_headersPlaceholder},
+            {"CFLAGS", joinFlags(prefixMaps, flags.m_sCFlags)},
+            {"CXXFLAGS", joinFlags(prefixMaps, flags.m_sCXXFlags)},
+        };
+
+        for (const auto& [name, value] :
+             getPortableToolchainVariables(
+                 SToolchain{flags.m_sCC, flags.m_sCXX, "", "", flags.m_sLDFlags})) {
+            portable.emplace_back(name, value);
+        }
+
+        std::string hashInput = getHostInput(flags);
+        SBuildEnvironment environment;
+
+        for (const std::string& name : c_passthroughVariables) {
+            if (const char* value = getenv(name.c_str())) {
+                environment.m_vVariables.emplace_back(name, value);
+            }
+        }
+
+        for (const auto& [name, value] : portable) {
+            hashInput += name + "=" + value + "\n";
+
+            std::string expanded = replaceAll(value, c_sourcePlaceholder, sourcePath.string());
+            expanded = replaceAll(expanded, c_headersPlaceholder, hyprlandHeadersPath.string());
+            expanded =
+                replaceAll(expanded, c_profilesPlaceholder, getPluginProfilesPath().string());
+
+            environment.m_vVariables.emplace_back(name, expanded);
+        }
+
+        // The same CC can name another compiler, or another release of it, on each host
+        environment.m_sHash = hashString(hashInput + getCompilerVersions(environment));
+
+        return environment;
+    }
+
+    std::string wrapCommand(const SBuildEnvironment& environment, const std::string& command) {
+        std::string wrapped = "env -i";
+
+        for (const auto& [name, value] : environment.m_vVariables) {
+            wrapped += " " + name + "=" + shellQuote(value);
+        }
+
+        return wrapped + " sh -c " + shellQuote(command);
+    }
+
+    std::string shellQuote(const std::string& value) {
+        return "'" + replaceAll(value, "'", "'\\''") + "'";
+    }
+}
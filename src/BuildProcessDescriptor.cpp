@@ -7,6 +7,7 @@ namespace hyprload {
         m_sName = std::move(name);
         m_pSource = source;
         m_sHyprlandHeadersPath = hyprlandHeadersPath;
+        m_eStage = pipeline::eStage::RESOLVE;
         m_rResult = std::nullopt;
     }
 }
@@ -0,0 +1,215 @@
+#include "Compression.hpp"
+#include "util.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HYPRLOAD_ZSTD
+#include <zstd.h>
+#endif
+
+namespace hyprload::compression {
+    // Decompression speed barely depends on the level, so installs can afford a high one
+    constexpr int c_compressionLevel = 12;
+
+    const std::filesystem::path c_memoryFileDirectory = "/proc/self/fd";
+
+    std::filesystem::path getCompressedPath(const std::filesystem::path& binary) {
+        std::filesystem::path compressedPath = binary;
+        compressedPath += c_extension;
+
+        return compressedPath;
+    }
+
+    bool isCompressed(const std::filesystem::path& path) {
+        return path.extension() == c_extension;
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    compressFile(const std::filesystem::path& source, const std::filesystem::path& target) {
+        std::string command = "zstd -q -f -" + std::to_string(c_compressionLevel) + " " +
+            source.string() + " -o " + target.string() + " 2>&1";
+
+        auto [exit, output] = executeCommand(command);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to compress " + source.filename().string() + ": " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+#ifdef HYPRLOAD_ZSTD
+    bool writeAll(fd_t fd, const char* data, usize length) {
+        while (length > 0) {
+            ssize_t written = write(fd, data, length);
+
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            data += written;
+            length -= written;
+        }
+
+        return true;
+    }
+
+    hyprload::Result<std::monostate, std::string> decompressInto(const std::filesystem::path& source,
+                                                                 fd_t fd) {
+        std::ifstream input = std::ifstream(source, std::ios::binary);
+
+        if (!input) {
+            return hyprload::Result<std::monostate, std::string>::err("Failed to open " +
+                                                                      source.string());
+        }
+
+        std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream =
+            std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)>(ZSTD_createDStream(),
+                                                                        &ZSTD_freeDStream);
+        std::vector<char> inputBuffer = std::vector<char>(ZSTD_DStreamInSize());
+        std::vector<char> outputBuffer = std::vector<char>(ZSTD_DStreamOutSize());
+        usize remaining = 0;
+
+        while (input.read(inputBuffer.data(), inputBuffer.size()) || input.gcount() > 0) {
+            ZSTD_inBuffer in = {inputBuffer.data(), static_cast<usize>(input.gcount()), 0};
+
+            while (in.pos < in.size) {
+                ZSTD_outBuffer out = {outputBuffer.data(), outputBuffer.size(), 0};
+
+                remaining = ZSTD_decompressStream(stream.get(), &out, &in);
+
+                if (ZSTD_isError(remaining)) {
+                    return hyprload::Result<std::monostate, std::string>::err(
+                        "Failed to decompress " + source.string() + ": " +
+                        ZSTD_getErrorName(remaining));
+                }
+
+                if (!writeAll(fd, outputBuffer.data(), out.pos)) {
+                    return hyprload::Result<std::monostate, std::string>::err(
+                        "Failed to write decompressed binary: " + std::string(strerror(errno)));
+                }
+            }
+        }
+
+        if (remaining != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(source.string() +
+                                                                      " is truncated");
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+#else
+    hyprload::Result<std::monostate, std::string> decompressInto(const std::filesystem::path& source,
+                                                                 fd_t fd) {
+        // Reopening the memory file through /proc lets zstd write straight into it, without
+        // handing the descriptor to every other command hyprload runs
+        std::string command = "zstd -q -d -c " + source.string() + " 2>&1 > /proc/" +
+            std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+
+        auto [exit, output] = executeCommand(command);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to decompress " + source.string() + ": " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+#endif
+
+    hyprload::Result<fd_t, std::string> decompressToMemory(const std::filesystem::path& source) {
+        // Named after the binary, which is what shows up in /proc/<pid>/maps
+        std::string name = source.stem().string();
+        unsigned int flags = MFD_CLOEXEC;
+
+#ifdef MFD_EXEC
+        // Explicitly executable, where vm.memfd_noexec would otherwise seal it noexec
+        flags |= MFD_EXEC;
+#endif
+
+        fd_t fd = memfd_create(name.c_str(), flags);
+
+        // Kernels before 6.3 reject the flag, and vm.memfd_noexec=2 refuses it. The memory file
+        // is then only loadable if it happens to be executable, see isExecutable()
+        if (fd < 0 && flags != MFD_CLOEXEC && (errno == EINVAL || errno == EACCES)) {
+            fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+        }
+
+        if (fd < 0) {
+            return hyprload::Result<fd_t, std::string>::err("Failed to create memory file: " +
+                                                            std::string(strerror(errno)));
+        }
+
+        auto result = decompressInto(source, fd);
+
+        if (result.isErr()) {
+            close(fd);
+
+            return hyprload::Result<fd_t, std::string>::err(result.unwrapErr());
+        }
+
+        return hyprload::Result<fd_t, std::string>::ok(std::move(fd));
+    }
+
+    hyprload::Result<std::filesystem::path, std::string>
+    decompressToFile(const std::filesystem::path& source, const std::filesystem::path& directory) {
+        std::string pattern = (directory / "decompressed.XXXXXX").string();
+
+        if (!mkdtemp(pattern.data())) {
+            return hyprload::Result<std::filesystem::path, std::string>::err(
+                "Failed to create " + pattern + ": " + std::string(strerror(errno)));
+        }
+
+        std::filesystem::path target = std::filesystem::path(pattern) / source.stem();
+        fd_t fd = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0700);
+
+        if (fd < 0) {
+            std::string message = "Failed to create " + target.string() + ": " + strerror(errno);
+            std::error_code ec;
+            std::filesystem::remove_all(pattern, ec);
+
+            return hyprload::Result<std::filesystem::path, std::string>::err(std::move(message));
+        }
+
+        auto result = decompressInto(source, fd);
+
+        close(fd);
+
+        if (result.isErr()) {
+            std::error_code ec;
+            std::filesystem::remove_all(pattern, ec);
+
+            return hyprload::Result<std::filesystem::path, std::string>::err(result.unwrapErr());
+        }
+
+        return hyprload::Result<std::filesystem::path, std::string>::ok(std::move(target));
+    }
+
+    bool isExecutable(fd_t fd) {
+        struct stat info;
+
+        return fstat(fd, &info) == 0 && (info.st_mode & S_IXUSR) != 0;
+    }
+
+    std::filesystem::path getMemoryFilePath(fd_t fd) {
+        return c_memoryFileDirectory / std::to_string(fd);
+    }
+
+    bool isMemoryFilePath(const std::filesystem::path& path) {
+        return path.parent_path() == c_memoryFileDirectory;
+    }
+}
@@ -0,0 +1,369 @@
+#include "ElfScanner.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hyprload::elf {
+    class MappedFile final {
+      public:
+        MappedFile(const std::filesystem::path& path) {
+            fd_t fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd < 0) {
+                return;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (data != MAP_FAILED) {
+                    m_pData = static_cast<const u8*>(data);
+                    m_iSize = st.st_size;
+                }
+            }
+
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (m_pData) {
+                munmap(const_cast<u8*>(m_pData), m_iSize);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Pointer to count objects of T at offset, or nullptr if that would read past the end
+        template <typename T>
+        const T* at(u64 offset, u64 count = 1) const {
+            if (!m_pData || offset > m_iSize || count > (m_iSize - offset) / sizeof(T)) {
+                return nullptr;
+            }
+
+            return reinterpret_cast<const T*>(m_pData + offset);
+        }
+
+        std::optional<std::string> stringAt(u64 tableOffset, u64 tableSize, u64 index) const {
+            if (index >= tableSize || !at<char>(tableOffset, tableSize)) {
+                return std::nullopt;
+            }
+
+            const char* table = reinterpret_cast<const char*>(m_pData + tableOffset);
+            usize length = strnlen(table + index, tableSize - index);
+
+            if (index + length >= tableSize) {
+                return std::nullopt;
+            }
+
+            return std::string(table + index, length);
+        }
+
+        bool isValid() const {
+            return m_pData != nullptr;
+        }
+
+      private:
+        const u8* m_pData = nullptr;
+        usize m_iSize = 0;
+    };
+
+    constexpr u64 align4(u64 value) {
+        return (value + 3) & ~u64(3);
+    }
+
+    std::optional<std::string> readHeadersNote(const MappedFile& file, const Elf64_Shdr& section) {
+        u64 offset = section.sh_offset;
+        u64 end = section.sh_offset + section.sh_size;
+
+        while (offset + sizeof(Elf64_Nhdr) <= end) {
+            const Elf64_Nhdr* note = file.at<Elf64_Nhdr>(offset);
+
+            if (!note) {
+                return std::nullopt;
+            }
+
+            u64 nameOffset = offset + sizeof(Elf64_Nhdr);
+            u64 descOffset = nameOffset + align4(note->n_namesz);
+
+            if (descOffset + note->n_descsz > end || !file.at<char>(descOffset, note->n_descsz)) {
+                return std::nullopt;
+            }
+
+            const char* name = file.at<char>(nameOffset, note->n_namesz);
+
+            if (name && note->n_type == c_noteTypeHeadersCommit &&
+                note->n_namesz == c_noteOwner.size() + 1 &&
+                std::memcmp(name, c_noteOwner.c_str(), note->n_namesz) == 0) {
+                return std::string(file.at<char>(descOffset, note->n_descsz), note->n_descsz);
+            }
+
+            offset = descOffset + align4(note->n_descsz);
+        }
+
+        return std::nullopt;
+    }
+
+    hyprload::Result<SElfInfo, std::string> scanElf(const std::filesystem::path& path) {
+        MappedFile file = MappedFile(path);
+
+        if (!file.isValid()) {
+            return hyprload::Result<SElfInfo, std::string>::err("Failed to map " + path.string());
+        }
+
+        const Elf64_Ehdr* header = file.at<Elf64_Ehdr>(0);
+
+        if (!header || std::memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+            return hyprload::Result<SElfInfo, std::string>::err(path.string() +
+                                                                " is not an ELF file");
+        }
+
+        if (header->e_ident[EI_CLASS] != ELFCLASS64 || header->e_ident[EI_DATA] != ELFDATA2LSB ||
+            header->e_shentsize != sizeof(Elf64_Shdr)) {
+            return hyprload::Result<SElfInfo, std::string>::err(path.string() +
+                                                                " has an unsupported ELF layout");
+        }
+
+        const Elf64_Shdr* sections = file.at<Elf64_Shdr>(header->e_shoff, header->e_shnum);
+
+        if (!sections || header->e_shstrndx >= header->e_shnum) {
+            return hyprload::Result<SElfInfo, std::string>::err(path.string() +
+                                                                " has a truncated section table");
+        }
+
+        const Elf64_Shdr& sectionNames = sections[header->e_shstrndx];
+        SElfInfo info;
+        std::optional<std::string> runPath = std::nullopt;
+        std::optional<std::string> rPath = std::nullopt;
+
+        for (u16 i = 0; i < header->e_shnum; i++) {
+            const Elf64_Shdr& section = sections[i];
+
+            // objcopy only types added sections as notes for some names, so match on the name
+            if (section.sh_type == SHT_NOTE || section.sh_type == SHT_PROGBITS) {
+                auto name =
+                    file.stringAt(sectionNames.sh_offset, sectionNames.sh_size, section.sh_name);
+
+                if (name.has_value() && name.value() == c_noteSection) {
+                    info.m_sHeadersCommit = readHeadersNote(file, section);
+                }
+                continue;
+            }
+
+            if (section.sh_type != SHT_DYNSYM && section.sh_type != SHT_DYNAMIC) {
+                continue;
+            }
+
+            if (section.sh_link >= header->e_shnum) {
+                continue;
+            }
+
+            const Elf64_Shdr& strings = sections[section.sh_link];
+
+            if (section.sh_type == SHT_DYNAMIC) {
+                const Elf64_Dyn* entries =
+                    file.at<Elf64_Dyn>(section.sh_offset, section.sh_size / sizeof(Elf64_Dyn));
+
+                for (u64 j = 0; entries && j < section.sh_size / sizeof(Elf64_Dyn); j++) {
+                    if (entries[j].d_tag == DT_NULL) {
+                        break;
+                    }
+
+                    if (entries[j].d_tag == DT_NEEDED) {
+                        auto needed =
+                            file.stringAt(strings.sh_offset, strings.sh_size, entries[j].d_un.d_val);
+
+                        if (needed.has_value()) {
+                            info.m_vNeeded.push_back(needed.value());
+                        }
+                    } else if (entries[j].d_tag == DT_RUNPATH) {
+                        runPath =
+                            file.stringAt(strings.sh_offset, strings.sh_size, entries[j].d_un.d_val);
+                    } else if (entries[j].d_tag == DT_RPATH) {
+                        rPath =
+                            file.stringAt(strings.sh_offset, strings.sh_size, entries[j].d_un.d_val);
+                    }
+                }
+            } else {
+                const Elf64_Sym* symbols =
+                    file.at<Elf64_Sym>(section.sh_offset, section.sh_size / sizeof(Elf64_Sym));
+
+                for (u64 j = 1; symbols && j < section.sh_size / sizeof(Elf64_Sym); j++) {
+                    const Elf64_Sym& symbol = symbols[j];
+
+                    if (symbol.st_shndx != SHN_UNDEF ||
+                        ELF64_ST_BIND(symbol.st_info) != STB_GLOBAL) {
+                        continue;
+                    }
+
+                    auto name = file.stringAt(strings.sh_offset, strings.sh_size, symbol.st_name);
+
+                    if (name.has_value() && !name.value().empty()) {
+                        info.m_vUndefinedSymbols.push_back(name.value());
+                    }
+                }
+            }
+        }
+
+        // The dynamic linker ignores DT_RPATH when DT_RUNPATH is present
+        std::istringstream paths = std::istringstream(runPath.value_or(rPath.value_or("")));
+        std::string directory;
+
+        while (std::getline(paths, directory, ':')) {
+            if (!directory.empty()) {
+                info.m_vRunPaths.push_back(directory);
+            }
+        }
+
+        return hyprload::Result<SElfInfo, std::string>::ok(std::move(info));
+    }
+
+    // Opens a needed library the way loading the plugin would, through its run paths first.
+    // $ORIGIN refers to wherever the binary was staged, so only absolute ones are searched
+    void* openNeeded(const std::string& needed, const std::vector<std::string>& runPaths) {
+        void* library = dlopen(needed.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+
+        if (library) {
+            return library;
+        }
+
+        for (const std::string& runPath : runPaths) {
+            if (needed.find('/') != std::string::npos ||
+                runPath.find("ORIGIN") != std::string::npos) {
+                continue;
+            }
+
+            library = dlopen((std::filesystem::path(runPath) / needed).c_str(),
+                             RTLD_LAZY | RTLD_LOCAL);
+
+            if (library) {
+                return library;
+            }
+        }
+
+        return dlopen(needed.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    checkCompatibility(const SElfInfo& info, const std::optional<std::string>& runningCommit) {
+        if (info.m_sHeadersCommit.has_value() && runningCommit.has_value() &&
+            info.m_sHeadersCommit.value() != runningCommit.value()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "built against Hyprland " + info.m_sHeadersCommit.value().substr(0, 7) +
+                ", running " + runningCommit.value().substr(0, 7));
+        }
+
+        std::vector<void*> libraries = std::vector<void*>();
+        std::optional<std::string> missingLibrary = std::nullopt;
+        // A library bundled next to the plugin may be found through $ORIGIN once it loads, so
+        // neither it nor the symbols it might provide can be checked
+        bool bundledLibrary = false;
+        bool hasOriginPath =
+            std::any_of(info.m_vRunPaths.begin(), info.m_vRunPaths.end(), [](const auto& path) {
+                return path.find("ORIGIN") != std::string::npos;
+            });
+
+        for (const std::string& needed : info.m_vNeeded) {
+            void* library = openNeeded(needed, info.m_vRunPaths);
+
+            if (!library && hasOriginPath) {
+                bundledLibrary = true;
+                continue;
+            }
+
+            if (!library) {
+                missingLibrary = needed;
+                break;
+            }
+
+            libraries.push_back(library);
+        }
+
+        std::optional<std::string> unresolved = std::nullopt;
+        usize unresolvedCount = 0;
+
+        for (const std::string& symbol : info.m_vUndefinedSymbols) {
+            if (missingLibrary.has_value() || bundledLibrary ||
+                dlsym(RTLD_DEFAULT, symbol.c_str())) {
+                continue;
+            }
+
+            bool found = false;
+            for (void* library : libraries) {
+                if (dlsym(library, symbol.c_str())) {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                if (!unresolved.has_value()) {
+                    unresolved = symbol;
+                }
+                unresolvedCount++;
+            }
+        }
+
+        for (void* library : libraries) {
+            dlclose(library);
+        }
+
+        if (missingLibrary.has_value()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "needs missing library " + missingLibrary.value());
+        }
+
+        if (unresolved.has_value()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                std::to_string(unresolvedCount) + " unresolved symbols, e.g. " +
+                unresolved.value());
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    writeHeadersNote(const std::filesystem::path& notePath, const std::string& headersCommit) {
+        Elf64_Nhdr note;
+        note.n_namesz = c_noteOwner.size() + 1;
+        note.n_descsz = headersCommit.size();
+        note.n_type = c_noteTypeHeadersCommit;
+
+        std::string name = c_noteOwner;
+        name.resize(align4(note.n_namesz), '\0');
+
+        std::string desc = headersCommit;
+        desc.resize(align4(note.n_descsz), '\0');
+
+        std::ofstream file = std::ofstream(notePath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open()) {
+            return hyprload::Result<std::monostate, std::string>::err("Failed to open " +
+                                                                      notePath.string());
+        }
+
+        file.write(reinterpret_cast<const char*>(&note), sizeof(note));
+        file.write(name.data(), name.size());
+        file.write(desc.data(), desc.size());
+
+        if (!file.good()) {
+            return hyprload::Result<std::monostate, std::string>::err("Failed to write " +
+                                                                      notePath.string());
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+}
@@ -0,0 +1,207 @@
+#include "GarbageCollector.hpp"
+#include "Hyprload.hpp"
+#include "HyprloadPlugin.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace hyprload::gc {
+    std::filesystem::file_time_type getLastUsed(const std::filesystem::path& path) {
+        std::error_code ec;
+        std::filesystem::file_time_type lastUsed = std::filesystem::last_write_time(path, ec);
+
+        if (ec) {
+            lastUsed = std::filesystem::file_time_type::min();
+        }
+
+        // git touches these on every fetch and checkout, the directory itself rarely changes
+        for (const auto& marker : {".git/FETCH_HEAD", ".git/HEAD", ".git/index"}) {
+            auto markerTime = std::filesystem::last_write_time(path / marker, ec);
+
+            if (!ec && markerTime > lastUsed) {
+                lastUsed = markerTime;
+            }
+        }
+
+        return lastUsed;
+    }
+
+    // The prefix the users of each kind of entry lock it with
+    std::string getLockPrefix(eGcEntryKind kind) {
+        switch (kind) {
+            case eGcEntryKind::SOURCE: return "source";
+            case eGcEntryKind::HEADERS: return "headers";
+            case eGcEntryKind::CACHE: return "cache";
+        }
+
+        return "cache";
+    }
+
+    GarbageCollector::GarbageCollector(std::vector<std::filesystem::path>&& referencedSources,
+                                       std::vector<std::string>&& requiredPlugins,
+                                       std::filesystem::path&& headersInUse, usize maxSize) {
+        m_vReferencedSources = std::move(referencedSources);
+        m_vRequiredPlugins = std::move(requiredPlugins);
+        m_pHeadersInUse = std::move(headersInUse);
+        m_iMaxSize = maxSize;
+        m_rResult = std::nullopt;
+    }
+
+    void GarbageCollector::collect() {
+        SGcStats stats;
+
+        try {
+            tryCleanupPreviousSessions();
+
+            stats.m_iBytesFreed += plugin::removeUnrequiredBinaries(m_vRequiredPlugins);
+
+            usize totalSize = getDiskUsage(getRootPath());
+
+            if (getCacheRootPath() != getRootPath()) {
+                totalSize += getDiskUsage(getCacheRootPath());
+            }
+            std::vector<SGcEntry> candidates = findCandidates();
+
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const SGcEntry& a, const SGcEntry& b) {
+                          return a.m_tLastUsed < b.m_tLastUsed;
+                      });
+
+            for (const SGcEntry& entry : candidates) {
+                if (m_iMaxSize != 0 && totalSize <= m_iMaxSize) {
+                    break;
+                }
+
+                // Skip anything another instance is working on right now
+                std::filesystem::path lockFile =
+                    getPathLockFile(getLockPrefix(entry.m_eKind), entry.m_pPath);
+                FileLock entryLock = FileLock(lockFile, false, false);
+
+                if (!entryLock.isLocked()) {
+                    debug("Skipping " + entry.m_pPath.string() + ", it is in use");
+                    continue;
+                }
+
+                debug("Evicting " + entry.m_pPath.string() + " (" +
+                      std::to_string(entry.m_iSize / 1024) + " KiB)");
+
+                std::error_code ec;
+                std::filesystem::remove_all(entry.m_pPath, ec);
+
+                if (ec) {
+                    debug("Failed to evict " + entry.m_pPath.string() + ": " + ec.message());
+                    continue;
+                }
+
+                totalSize -= std::min(totalSize, entry.m_iSize);
+                stats.m_iBytesFreed += entry.m_iSize;
+                stats.m_iEntriesRemoved++;
+            }
+
+            stats.m_iBytesRemaining = totalSize;
+        } catch (const std::exception& e) {
+            auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+            m_rResult = hyprload::Result<SGcStats, std::string>::err(
+                "Failed to collect garbage: " + std::string(e.what()));
+            return;
+        }
+
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        m_rResult = hyprload::Result<SGcStats, std::string>::ok(std::move(stats));
+    }
+
+    std::vector<SGcEntry> GarbageCollector::findCandidates() {
+        std::vector<SGcEntry> candidates = std::vector<SGcEntry>();
+
+        std::filesystem::path sourcesPath = getPluginSourcesPath();
+
+        if (std::filesystem::exists(sourcesPath)) {
+            for (const auto& entry : std::filesystem::directory_iterator(sourcesPath)) {
+                if (isReferencedSource(entry.path())) {
+                    continue;
+                }
+
+                candidates.push_back(SGcEntry{entry.path(), eGcEntryKind::SOURCE,
+                                              getDiskUsage(entry.path()),
+                                              getLastUsed(entry.path())});
+            }
+        }
+
+        std::filesystem::path headersPath = getDefaultHyprlandHeadersPath();
+
+        if (std::filesystem::exists(headersPath)) {
+            // The tree builds use is never evicted, however long it sat unused
+            if (headersPath != m_pHeadersInUse) {
+                candidates.push_back(SGcEntry{headersPath, eGcEntryKind::HEADERS,
+                                              getDiskUsage(headersPath),
+                                              getLastUsed(headersPath)});
+            }
+        }
+
+        std::filesystem::path cachePath = getCachePath();
+
+        if (std::filesystem::exists(cachePath)) {
+            for (const auto& entry : std::filesystem::directory_iterator(cachePath)) {
+                // Trees extracted from archives, one per commit
+                if (entry.path().filename() == "headers") {
+                    for (const auto& tree : std::filesystem::directory_iterator(entry.path())) {
+                        // Submodule commits of every extracted tree, not a tree itself
+                        if (tree.path().filename() == ".index.git") {
+                            continue;
+                        }
+
+                        if (tree.path() != m_pHeadersInUse) {
+                            candidates.push_back(SGcEntry{tree.path(), eGcEntryKind::HEADERS,
+                                                          getDiskUsage(tree.path()),
+                                                          getLastUsed(tree.path())});
+                        }
+                    }
+                    continue;
+                }
+
+                candidates.push_back(SGcEntry{entry.path(), eGcEntryKind::CACHE,
+                                              getDiskUsage(entry.path()),
+                                              getLastUsed(entry.path())});
+            }
+        }
+
+        // Trees left in the root from before switching to the XDG layout are never used again
+        if (getCacheRootPath() != getRootPath()) {
+            for (const auto& legacyDirectory : {getPluginsPath() / "src", getRootPath() / "cache"}) {
+                if (!std::filesystem::exists(legacyDirectory)) {
+                    continue;
+                }
+
+                for (const auto& entry : std::filesystem::directory_iterator(legacyDirectory)) {
+                    candidates.push_back(SGcEntry{entry.path(), eGcEntryKind::CACHE,
+                                                  getDiskUsage(entry.path()),
+                                                  getLastUsed(entry.path())});
+                }
+            }
+
+            for (const auto& legacyTree : {getRootPath() / "hyprland", getRootPath() / "src"}) {
+                if (std::filesystem::exists(legacyTree)) {
+                    candidates.push_back(SGcEntry{legacyTree, eGcEntryKind::CACHE,
+                                                  getDiskUsage(legacyTree),
+                                                  getLastUsed(legacyTree)});
+                }
+            }
+        }
+
+        return candidates;
+    }
+
+    bool GarbageCollector::isReferencedSource(const std::filesystem::path& path) const {
+        return std::any_of(m_vReferencedSources.begin(), m_vReferencedSources.end(),
+                           [&path](const std::filesystem::path& source) {
+                               std::error_code ec;
+                               return std::filesystem::equivalent(source, path, ec) ||
+                                   source.lexically_normal() == path.lexically_normal();
+                           });
+    }
+}
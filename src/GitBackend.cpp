@@ -0,0 +1,519 @@
+#include "GitBackend.hpp"
+#include "util.hpp"
+
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#ifdef HYPRLOAD_LIBGIT2
+#include <git2.h>
+#endif
+
+namespace hyprload::git {
+    class CliBackend final : public GitBackend {
+      public:
+        hyprload::Result<std::monostate, std::string>
+        clone(const std::string& url, const std::string& branch, const std::filesystem::path& path,
+              usize depth, bool recurseSubmodules, const ProgressCallback&) override {
+            std::string command = "git clone " + url + " " + path.string();
+
+            if (!branch.empty()) {
+                command += " --branch " + branch;
+            }
+
+            if (depth > 0) {
+                command += " --depth " + std::to_string(depth);
+            }
+
+            if (recurseSubmodules) {
+                command += " --recurse-submodules";
+            }
+
+            return run(command, "Failed to clone " + url);
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        fetch(const std::filesystem::path& path, const ProgressCallback&) override {
+            return run("git -C " + path.string() + " fetch origin",
+                       "Failed to fetch " + path.string());
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        fastForward(const std::filesystem::path& path) override {
+            return run("git -C " + path.string() + " merge --ff-only @{u}",
+                       "Failed to fast-forward " + path.string());
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        checkout(const std::filesystem::path& path, const std::string& commit,
+                 bool recurseSubmodules) override {
+            return run("git -C " + path.string() + " checkout --detach " + commit +
+                           (recurseSubmodules ? " --recurse-submodules" : ""),
+                       "Failed to checkout to " + commit);
+        }
+
+        hyprload::Result<eBranchStatus, std::string>
+        getBranchStatus(const std::filesystem::path& path) override {
+            auto [exit, output] = executeCommand("git -C " + path.string() +
+                                                 " rev-list --left-right --count HEAD...@{u} 2>&1");
+
+            std::istringstream counts = std::istringstream(output);
+            usize ahead = 0;
+            usize behind = 0;
+
+            if (exit != 0 || !(counts >> ahead >> behind)) {
+                return hyprload::Result<eBranchStatus, std::string>::err(
+                    "Failed to compare " + path.string() + " with its upstream: " + output);
+            }
+
+            return hyprload::Result<eBranchStatus, std::string>::ok(toBranchStatus(ahead, behind));
+        }
+
+        std::optional<std::string> getHead(const std::filesystem::path& path) override {
+            auto [exit, output] =
+                executeCommand("git -C " + path.string() + " rev-parse HEAD 2>/dev/null");
+
+            if (exit != 0 || output.size() < 40) {
+                return std::nullopt;
+            }
+
+            return output.substr(0, 40);
+        }
+
+        std::optional<i64> getCommitTime(const std::filesystem::path& path) override {
+            auto [exit, output] =
+                executeCommand("git -C " + path.string() + " log -1 --format=%ct HEAD 2>/dev/null");
+
+            if (exit != 0 || output.empty()) {
+                return std::nullopt;
+            }
+
+            return std::strtoll(output.c_str(), nullptr, 10);
+        }
+
+        std::optional<std::string> lsRemote(const std::string& url,
+                                            const std::string& ref) override {
+            auto [exit, output] = executeCommand("git ls-remote " + url + " " + ref + " 2>/dev/null");
+
+            if (exit != 0 || output.size() < 40) {
+                return std::nullopt;
+            }
+
+            return output.substr(0, 40);
+        }
+
+        static eBranchStatus toBranchStatus(usize ahead, usize behind) {
+            if (ahead > 0 && behind > 0) {
+                return eBranchStatus::DIVERGED;
+            } else if (ahead > 0) {
+                return eBranchStatus::AHEAD;
+            } else if (behind > 0) {
+                return eBranchStatus::BEHIND;
+            }
+
+            return eBranchStatus::UP_TO_DATE;
+        }
+
+      private:
+        static hyprload::Result<std::monostate, std::string> run(const std::string& command,
+                                                                 const std::string& failure) {
+            auto [exit, output] = executeCommand(command + " 2>&1");
+
+            if (exit != 0) {
+                return hyprload::Result<std::monostate, std::string>::err(failure + ": " +
+                                                                          output);
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+    };
+
+#ifdef HYPRLOAD_LIBGIT2
+    template <typename T, void (*Free)(T*)>
+    struct SGitDeleter {
+        void operator()(T* object) const {
+            Free(object);
+        }
+    };
+
+    template <typename T, void (*Free)(T*)>
+    using GitPtr = std::unique_ptr<T, SGitDeleter<T, Free>>;
+
+    typedef GitPtr<git_repository, git_repository_free> RepositoryPtr;
+    typedef GitPtr<git_reference, git_reference_free> ReferencePtr;
+    typedef GitPtr<git_remote, git_remote_free> RemotePtr;
+    typedef GitPtr<git_object, git_object_free> ObjectPtr;
+    typedef GitPtr<git_commit, git_commit_free> CommitPtr;
+
+    std::string getLastError(const std::string& what) {
+        const git_error* error = git_error_last();
+
+        return what + ": " + (error && error->message ? error->message : "unknown error");
+    }
+
+    std::string toString(const git_oid* oid) {
+        char buffer[41];
+        git_oid_tostr(buffer, sizeof(buffer), oid);
+
+        return std::string(buffer);
+    }
+
+    int onTransferProgress(const git_indexer_progress* stats, void* payload) {
+        const ProgressCallback* progress = static_cast<const ProgressCallback*>(payload);
+
+        if (progress && *progress) {
+            (*progress)(SProgress{stats->received_objects, stats->total_objects,
+                                  stats->received_bytes});
+        }
+
+        return 0;
+    }
+
+    int updateSubmodule(git_submodule* submodule, const char*, void*) {
+        git_submodule_update_options options = GIT_SUBMODULE_UPDATE_OPTIONS_INIT;
+
+        return git_submodule_update(submodule, 1, &options);
+    }
+
+    class LibGit2Backend final : public GitBackend {
+      public:
+        LibGit2Backend() {
+            git_libgit2_init();
+        }
+
+        ~LibGit2Backend() {
+            git_libgit2_shutdown();
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        clone(const std::string& url, const std::string& branch, const std::filesystem::path& path,
+              usize depth, bool recurseSubmodules, const ProgressCallback& progress) override {
+            if (!isSupported(url)) {
+                return m_cli.clone(url, branch, path, depth, recurseSubmodules, progress);
+            }
+
+            git_clone_options options = GIT_CLONE_OPTIONS_INIT;
+
+            if (!branch.empty()) {
+                options.checkout_branch = branch.c_str();
+            }
+
+            setFetchOptions(options.fetch_opts, progress);
+
+#if LIBGIT2_VER_MAJOR > 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR >= 7)
+            options.fetch_opts.depth = depth;
+#endif
+
+            git_repository* repository = nullptr;
+
+            if (git_clone(&repository, url.c_str(), path.c_str(), &options) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to clone " + url));
+            }
+
+            RepositoryPtr owned = RepositoryPtr(repository);
+
+            if (recurseSubmodules) {
+                return updateSubmodules(owned.get());
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        fetch(const std::filesystem::path& path, const ProgressCallback& progress) override {
+            RepositoryPtr repository = open(path);
+            git_remote* remote = nullptr;
+
+            if (!repository || git_remote_lookup(&remote, repository.get(), "origin") < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to open " + path.string()));
+            }
+
+            RemotePtr owned = RemotePtr(remote);
+
+            if (!isSupported(git_remote_url(remote))) {
+                return m_cli.fetch(path, progress);
+            }
+
+            git_fetch_options options = GIT_FETCH_OPTIONS_INIT;
+            setFetchOptions(options, progress);
+
+            if (git_remote_fetch(remote, nullptr, &options, "fetch") < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to fetch " + path.string()));
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        fastForward(const std::filesystem::path& path) override {
+            auto status = getBranchStatus(path);
+
+            if (status.isErr()) {
+                return hyprload::Result<std::monostate, std::string>::err(status.unwrapErr());
+            }
+
+            if (status.unwrap() == eBranchStatus::UP_TO_DATE) {
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            }
+
+            if (status.unwrap() != eBranchStatus::BEHIND) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    path.string() + " has local commits, refusing to update it");
+            }
+
+            RepositoryPtr repository = open(path);
+            git_reference* head = nullptr;
+            git_reference* upstream = nullptr;
+
+            if (!repository || git_repository_head(&head, repository.get()) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to read HEAD of " + path.string()));
+            }
+
+            ReferencePtr ownedHead = ReferencePtr(head);
+
+            if (git_branch_upstream(&upstream, head) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to find the upstream of " + path.string()));
+            }
+
+            ReferencePtr ownedUpstream = ReferencePtr(upstream);
+            const git_oid* target = git_reference_target(upstream);
+
+            auto result = checkoutObject(repository.get(), target);
+
+            if (result.isErr()) {
+                return result;
+            }
+
+            git_reference* updated = nullptr;
+
+            if (git_reference_set_target(&updated, head, target, "hyprload: fast-forward") < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to move HEAD of " + path.string()));
+            }
+
+            git_reference_free(updated);
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        hyprload::Result<std::monostate, std::string>
+        checkout(const std::filesystem::path& path, const std::string& commit,
+                 bool recurseSubmodules) override {
+            RepositoryPtr repository = open(path);
+            git_object* object = nullptr;
+
+            if (!repository || git_revparse_single(&object, repository.get(), commit.c_str()) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to find " + commit));
+            }
+
+            ObjectPtr owned = ObjectPtr(object);
+
+            auto result = checkoutObject(repository.get(), git_object_id(object));
+
+            if (result.isErr()) {
+                return result;
+            }
+
+            if (git_repository_set_head_detached(repository.get(), git_object_id(object)) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to detach HEAD at " + commit));
+            }
+
+            if (recurseSubmodules) {
+                return updateSubmodules(repository.get());
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        hyprload::Result<eBranchStatus, std::string>
+        getBranchStatus(const std::filesystem::path& path) override {
+            RepositoryPtr repository = open(path);
+            git_reference* head = nullptr;
+            git_reference* upstream = nullptr;
+
+            if (!repository || git_repository_head(&head, repository.get()) < 0) {
+                return hyprload::Result<eBranchStatus, std::string>::err(
+                    getLastError("Failed to read HEAD of " + path.string()));
+            }
+
+            ReferencePtr ownedHead = ReferencePtr(head);
+
+            if (git_branch_upstream(&upstream, head) < 0) {
+                return hyprload::Result<eBranchStatus, std::string>::err(
+                    getLastError("Failed to find the upstream of " + path.string()));
+            }
+
+            ReferencePtr ownedUpstream = ReferencePtr(upstream);
+            size_t ahead = 0;
+            size_t behind = 0;
+
+            if (git_graph_ahead_behind(&ahead, &behind, repository.get(), git_reference_target(head),
+                                       git_reference_target(upstream)) < 0) {
+                return hyprload::Result<eBranchStatus, std::string>::err(
+                    getLastError("Failed to compare " + path.string() + " with its upstream"));
+            }
+
+            return hyprload::Result<eBranchStatus, std::string>::ok(
+                CliBackend::toBranchStatus(ahead, behind));
+        }
+
+        std::optional<std::string> getHead(const std::filesystem::path& path) override {
+            RepositoryPtr repository = open(path);
+            git_oid oid;
+
+            if (!repository || git_reference_name_to_id(&oid, repository.get(), "HEAD") < 0) {
+                return std::nullopt;
+            }
+
+            return toString(&oid);
+        }
+
+        std::optional<i64> getCommitTime(const std::filesystem::path& path) override {
+            RepositoryPtr repository = open(path);
+            git_oid oid;
+            git_commit* commit = nullptr;
+
+            if (!repository || git_reference_name_to_id(&oid, repository.get(), "HEAD") < 0 ||
+                git_commit_lookup(&commit, repository.get(), &oid) < 0) {
+                return std::nullopt;
+            }
+
+            CommitPtr owned = CommitPtr(commit);
+
+            return static_cast<i64>(git_commit_time(commit));
+        }
+
+        std::optional<std::string> lsRemote(const std::string& url,
+                                            const std::string& ref) override {
+            if (!isSupported(url)) {
+                return m_cli.lsRemote(url, ref);
+            }
+
+            git_remote* remote = nullptr;
+
+            if (git_remote_create_detached(&remote, url.c_str()) < 0) {
+                return std::nullopt;
+            }
+
+            RemotePtr owned = RemotePtr(remote);
+            git_remote_callbacks callbacks = GIT_REMOTE_CALLBACKS_INIT;
+
+            if (git_remote_connect(remote, GIT_DIRECTION_FETCH, &callbacks, nullptr, nullptr) < 0) {
+                return std::nullopt;
+            }
+
+            const git_remote_head** heads = nullptr;
+            size_t count = 0;
+
+            if (git_remote_ls(&heads, &count, remote) < 0) {
+                return std::nullopt;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                if (ref == heads[i]->name) {
+                    return toString(&heads[i]->oid);
+                }
+            }
+
+            return std::nullopt;
+        }
+
+      private:
+        static RepositoryPtr open(const std::filesystem::path& path) {
+            git_repository* repository = nullptr;
+
+            if (git_repository_open(&repository, path.c_str()) < 0) {
+                return RepositoryPtr();
+            }
+
+            return RepositoryPtr(repository);
+        }
+
+        static void setFetchOptions(git_fetch_options& options, const ProgressCallback& progress) {
+            options.callbacks.transfer_progress = onTransferProgress;
+            options.callbacks.payload = const_cast<ProgressCallback*>(&progress);
+        }
+
+        static hyprload::Result<std::monostate, std::string>
+        checkoutObject(git_repository* repository, const git_oid* oid) {
+            git_object* object = nullptr;
+
+            if (git_object_lookup(&object, repository, oid, GIT_OBJECT_COMMIT) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to find commit " + toString(oid)));
+            }
+
+            ObjectPtr owned = ObjectPtr(object);
+            git_checkout_options options = GIT_CHECKOUT_OPTIONS_INIT;
+            options.checkout_strategy = GIT_CHECKOUT_SAFE;
+
+            if (git_checkout_tree(repository, object, &options) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to check out " + toString(oid)));
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        static hyprload::Result<std::monostate, std::string>
+        updateSubmodules(git_repository* repository) {
+            if (git_submodule_foreach(repository, updateSubmodule, nullptr) < 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    getLastError("Failed to update submodules"));
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        // libgit2 is often built without SSH, leave those remotes to the git CLI
+        static bool isSupported(const std::string& url) {
+            bool ssh = url.rfind("git@", 0) == 0 || url.rfind("ssh://", 0) == 0;
+
+            return !ssh || (git_libgit2_features() & GIT_FEATURE_SSH);
+        }
+
+        CliBackend m_cli;
+    };
+#endif
+
+    GitBackend& getBackend() {
+#ifdef HYPRLOAD_LIBGIT2
+        static LibGit2Backend backend;
+#else
+        static CliBackend backend;
+#endif
+
+        return backend;
+    }
+
+    ProgressCallback makeProgressReporter(const std::string& what) {
+        std::shared_ptr<usize> reportedQuarter = std::make_shared<usize>(0);
+
+        return [what, reportedQuarter](const SProgress& progress) {
+            if (progress.m_iTotalObjects == 0) {
+                return;
+            }
+
+            usize quarter = progress.m_iReceivedObjects * 4 / progress.m_iTotalObjects;
+
+            if (quarter <= *reportedQuarter) {
+                return;
+            }
+
+            *reportedQuarter = quarter;
+
+            debug(what + ": " + std::to_string(quarter * 25) + "% of " +
+                  std::to_string(progress.m_iTotalObjects) + " objects, " +
+                  std::to_string(progress.m_iReceivedBytes / 1024) + " KiB");
+        };
+    }
+}
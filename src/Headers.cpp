@@ -0,0 +1,725 @@
+#include "Headers.hpp"
+#include "GitBackend.hpp"
+#include "SharedCache.hpp"
+#include "util.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+namespace hyprload::headers {
+    const std::string c_hyprlandUrl = "https://github.com/hyprwm/Hyprland.git";
+
+    std::string trim(const std::string& value) {
+        usize start = value.find_first_not_of(" \t\r\n");
+        usize end = value.find_last_not_of(" \t\r\n");
+
+        if (start == std::string::npos) {
+            return "";
+        }
+
+        return value.substr(start, end - start + 1);
+    }
+
+    std::string readFile(const std::filesystem::path& path) {
+        std::ifstream file = std::ifstream(path, std::ios::binary);
+
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Just enough of make's variable syntax for the protocol rules: $(VAR) and $(shell ...)
+    class MakefileVariables final {
+      public:
+        void set(const std::string& name, const std::string& value) {
+            m_mVariables[name] = value;
+        }
+
+        std::string expand(const std::string& value, usize depth = 0) {
+            if (depth > 8) {
+                return value;
+            }
+
+            std::string expanded;
+            usize i = 0;
+
+            while (i < value.size()) {
+                if (value[i] != '$' || i + 1 >= value.size() || value[i + 1] != '(') {
+                    expanded += value[i++];
+                    continue;
+                }
+
+                usize close = findClosing(value, i + 1);
+
+                if (close == std::string::npos) {
+                    expanded += value.substr(i);
+                    break;
+                }
+
+                std::string inner = expand(value.substr(i + 2, close - i - 2), depth + 1);
+
+                if (inner.rfind("shell ", 0) == 0) {
+                    expanded += runShell(inner.substr(6));
+                } else if (m_mVariables.contains(inner)) {
+                    expanded += expand(m_mVariables[inner], depth + 1);
+                }
+
+                i = close + 1;
+            }
+
+            return expanded;
+        }
+
+      private:
+        static usize findClosing(const std::string& value, usize open) {
+            usize level = 0;
+
+            for (usize i = open; i < value.size(); i++) {
+                if (value[i] == '(') {
+                    level++;
+                } else if (value[i] == ')' && --level == 0) {
+                    return i;
+                }
+            }
+
+            return std::string::npos;
+        }
+
+        std::string runShell(const std::string& command) {
+            if (!m_mShellResults.contains(command)) {
+                auto [exit, output] = executeCommand(command + " 2>/dev/null");
+
+                m_mShellResults[command] = exit == 0 ? trim(output) : "";
+            }
+
+            return m_mShellResults[command];
+        }
+
+        std::unordered_map<std::string, std::string> m_mVariables;
+        std::unordered_map<std::string, std::string> m_mShellResults;
+    };
+
+    struct SProtocolHeader {
+        std::string m_sScanner;
+        std::string m_sMode;
+        std::filesystem::path m_pInput;
+        std::filesystem::path m_pOutput;
+    };
+
+    // The header rules of the tree's Makefile, i.e. every `wayland-scanner *-header` recipe
+    std::vector<SProtocolHeader> findProtocolHeaders(const std::filesystem::path& tree) {
+        std::vector<SProtocolHeader> headers = std::vector<SProtocolHeader>();
+        std::ifstream makefile = std::ifstream(tree / "Makefile");
+
+        if (!makefile.is_open()) {
+            return headers;
+        }
+
+        MakefileVariables variables;
+        std::string target;
+        std::string line;
+
+        while (std::getline(makefile, line)) {
+            std::string continuation;
+
+            while (!line.empty() && line.back() == '\\' && std::getline(makefile, continuation)) {
+                line.pop_back();
+                line += " " + continuation;
+            }
+
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            if (line[0] != '\t') {
+                usize assignment = line.find('=');
+                usize colon = line.find(':');
+
+                if (assignment != std::string::npos &&
+                    (colon == std::string::npos || colon >= assignment - 1)) {
+                    std::string name = line.substr(0, assignment);
+
+                    while (!name.empty() && (name.back() == ':' || name.back() == '?' ||
+                                             name.back() == '+' || name.back() == ' ')) {
+                        name.pop_back();
+                    }
+
+                    variables.set(trim(name), trim(line.substr(assignment + 1)));
+                } else if (colon != std::string::npos) {
+                    target = trim(line.substr(0, colon));
+                }
+
+                continue;
+            }
+
+            if (line.find("wayland-scanner") == std::string::npos &&
+                line.find("WAYLAND_SCANNER") == std::string::npos) {
+                continue;
+            }
+
+            std::istringstream tokens = std::istringstream(variables.expand(line));
+            std::vector<std::string> words = std::vector<std::string>();
+            std::string word;
+
+            while (tokens >> word) {
+                words.push_back(word);
+            }
+
+            for (usize i = 0; i + 3 < words.size(); i++) {
+                if (!words[i].ends_with("wayland-scanner") || !words[i + 1].ends_with("-header")) {
+                    continue;
+                }
+
+                std::string output = words[i + 3] == "$@" ? target : words[i + 3];
+
+                headers.push_back(SProtocolHeader{words[i], words[i + 1],
+                                                  tree / words[i + 2], tree / output});
+                break;
+            }
+        }
+
+        return headers;
+    }
+
+    // Runs a generator into the generated-files cache keyed by inputKey, then copies the
+    // result into the tree. Outputs of unchanged inputs are reused across commits
+    hyprload::Result<std::monostate, std::string>
+    generateCached(const std::string& inputKey, const std::filesystem::path& output,
+                   const std::function<bool(const std::filesystem::path&)>& generate) {
+        std::filesystem::path generatedPath = getCachePath() / "generated";
+        std::filesystem::path cached = generatedPath / hashString(inputKey) / output.filename();
+        std::error_code ec;
+
+        // Shared between generators, the garbage collector skips the cache while it is held
+        FileLock generatedLock = FileLock(getPathLockFile("cache", generatedPath), true);
+
+        if (!std::filesystem::exists(cached)) {
+            std::filesystem::path stagingPath = cached.parent_path();
+            stagingPath += ".tmp." + std::to_string(getpid());
+
+            std::filesystem::remove_all(stagingPath, ec);
+            std::filesystem::create_directories(stagingPath, ec);
+
+            if (!generate(stagingPath / output.filename())) {
+                std::filesystem::remove_all(stagingPath, ec);
+
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to generate " + output.filename().string());
+            }
+
+            std::filesystem::rename(stagingPath, cached.parent_path(), ec);
+
+            // Another instance generating the same inputs got there first, its output is as good
+            if (ec && std::filesystem::exists(cached)) {
+                ec.clear();
+            }
+
+            std::error_code removeEc;
+            std::filesystem::remove_all(stagingPath, removeEc);
+
+            if (ec) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to cache " + output.filename().string() + ": " + ec.message());
+            }
+        } else {
+            // Keeps the entry young for the garbage collector
+            std::filesystem::last_write_time(cached.parent_path(),
+                                             std::filesystem::file_time_type::clock::now(), ec);
+        }
+
+        std::filesystem::create_directories(output.parent_path(), ec);
+        std::filesystem::copy(cached, output,
+                              std::filesystem::copy_options::overwrite_existing |
+                                  std::filesystem::copy_options::recursive,
+                              ec);
+
+        if (ec) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to copy " + output.filename().string() + ": " + ec.message());
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    generateProtocolHeaders(const std::filesystem::path& tree) {
+        std::vector<SProtocolHeader> headers = findProtocolHeaders(tree);
+
+        if (headers.empty()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "No protocol rules found in the Hyprland Makefile");
+        }
+
+        auto [exit, scannerVersion] = executeCommand(headers[0].m_sScanner + " --version 2>&1");
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "wayland-scanner is not available");
+        }
+
+        for (const SProtocolHeader& header : headers) {
+            std::string protocol = readFile(header.m_pInput);
+
+            if (protocol.empty()) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Missing protocol " + header.m_pInput.string());
+            }
+
+            std::string inputKey = "wayland-scanner\n" + trim(scannerVersion) + "\n" +
+                header.m_sMode + "\n" + protocol;
+
+            auto result =
+                generateCached(inputKey, header.m_pOutput, [&header](const std::filesystem::path& out) {
+                    return std::get<0>(executeCommand(header.m_sScanner + " " + header.m_sMode +
+                                                      " " + header.m_pInput.string() + " " +
+                                                      out.string() + " 2>&1")) == 0;
+                });
+
+            if (result.isErr()) {
+                return result;
+            }
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    // wlroots' config.h and version.h only exist after meson has configured it, which only
+    // depends on the submodule commit
+    hyprload::Result<std::monostate, std::string>
+    generateWlrootsHeaders(const std::filesystem::path& tree) {
+        std::filesystem::path wlroots = tree / "subprojects" / "wlroots";
+
+        if (!std::filesystem::exists(wlroots / "meson.build")) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        std::optional<std::string> wlrootsCommit = getHeadersCommit(wlroots);
+
+        if (!wlrootsCommit.has_value()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to determine the wlroots commit");
+        }
+
+        return generateCached("wlroots\n" + wlrootsCommit.value(), wlroots / "build" / "include",
+                              [&wlroots](const std::filesystem::path& out) {
+                                  std::filesystem::path build = out.parent_path() / "build";
+
+                                  std::string command = "meson setup " + build.string() + " " +
+                                      wlroots.string() + " --buildtype=release 2>&1";
+
+                                  if (std::get<0>(executeCommand(command)) != 0) {
+                                      return false;
+                                  }
+
+                                  std::error_code ec;
+                                  std::filesystem::rename(build / "include", out, ec);
+                                  std::filesystem::remove_all(build, ec);
+
+                                  return std::filesystem::exists(out);
+                              });
+    }
+
+    hyprload::Result<std::monostate, std::string> generateHeaders(const std::filesystem::path& tree) {
+        auto result = generateProtocolHeaders(tree);
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        result = generateWlrootsHeaders(tree);
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        // Cheap, and depends on the checked out commit anyway
+        if (std::filesystem::exists(tree / "scripts" / "generateVersion.sh")) {
+            auto [exit, output] =
+                executeCommand("cd " + tree.string() + " && ./scripts/generateVersion.sh 2>&1");
+
+            if (exit != 0) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to generate version.h: " + output);
+            }
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    std::string formatArchiveUrl(const std::string& archiveTemplate, const std::string& repo,
+                                 const std::string& commit) {
+        std::string url = archiveTemplate;
+
+        for (const auto& [placeholder, value] :
+             {std::pair<std::string, std::string>{"{repo}", repo}, {"{commit}", commit}}) {
+            for (usize at = url.find(placeholder); at != std::string::npos;
+                 at = url.find(placeholder, at + value.size())) {
+                url.replace(at, placeholder.size(), value);
+            }
+        }
+
+        return url;
+    }
+
+    // owner/name of a GitHub-style remote, as used for {repo}
+    std::string getRepoName(const std::string& url) {
+        std::string repo = url;
+
+        if (repo.ends_with(".git")) {
+            repo.resize(repo.size() - 4);
+        }
+
+        usize name = repo.find_last_of('/');
+        usize owner = name == std::string::npos ? std::string::npos
+                                                : repo.find_last_of("/:", name - 1);
+
+        return owner == std::string::npos ? repo : repo.substr(owner + 1);
+    }
+
+    // Streams the archive straight into tar, dropping the archive's top-level directory
+    hyprload::Result<std::monostate, std::string>
+    extractArchive(const std::string& archiveTemplate, const std::string& repo,
+                   const std::string& commit, const std::filesystem::path& destination) {
+        std::string url = formatArchiveUrl(archiveTemplate, repo, commit);
+
+        if (url.rfind("file://", 0) == 0) {
+            url = url.substr(7);
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(destination, ec);
+
+        std::string command = url[0] == '/'
+            ? "tar -xf " + url + " --strip-components=1 -C " + destination.string() + " 2>&1"
+            : "curl -fsSL " + url + " | tar -xzf - --strip-components=1 -C " +
+                destination.string() + " 2>&1";
+
+        auto [exit, output] = executeCommand(command);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to extract " + url + ": " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    struct SSubmodule {
+        std::string m_sPath;
+        std::string m_sUrl;
+    };
+
+    std::vector<SSubmodule> readSubmodules(const std::filesystem::path& tree) {
+        std::vector<SSubmodule> submodules = std::vector<SSubmodule>();
+        std::ifstream gitmodules = std::ifstream(tree / ".gitmodules");
+        std::string line;
+
+        while (std::getline(gitmodules, line)) {
+            line = trim(line);
+
+            if (line.rfind("[submodule", 0) == 0) {
+                submodules.push_back(SSubmodule{});
+                continue;
+            }
+
+            usize assignment = line.find('=');
+
+            if (submodules.empty() || assignment == std::string::npos) {
+                continue;
+            }
+
+            std::string key = trim(line.substr(0, assignment));
+            std::string value = trim(line.substr(assignment + 1));
+
+            if (key == "path") {
+                submodules.back().m_sPath = value;
+            } else if (key == "url") {
+                submodules.back().m_sUrl = value;
+            }
+        }
+
+        return submodules;
+    }
+
+    // Gitlinks written into the archive when it was built
+    std::optional<std::string> readArchivedSubmoduleCommit(const std::filesystem::path& tree,
+                                                           const std::string& path) {
+        std::ifstream submodules = std::ifstream(tree / c_archiveSubmodulesFile);
+        std::string line;
+
+        while (std::getline(submodules, line)) {
+            std::istringstream entry = std::istringstream(line);
+            std::string sha, submodulePath;
+
+            if (entry >> sha >> submodulePath && submodulePath == path) {
+                return sha;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Archives do not record submodule commits, so unless the archive lists them, read the
+    // gitlinks from a blobless fetch of just that commit, which transfers trees but no file
+    // contents
+    std::optional<std::string> getSubmoduleCommit(const std::filesystem::path& tree,
+                                                  const std::string& commit,
+                                                  const std::string& path) {
+        if (std::optional<std::string> archived = readArchivedSubmoduleCommit(tree, path)) {
+            return archived;
+        }
+
+        std::filesystem::path index = getCachePath() / "headers" / ".index.git";
+
+        if (!std::filesystem::exists(index)) {
+            std::string command = "git init --bare -q " + index.string() + " && git -C " +
+                index.string() + " remote add origin " + c_hyprlandUrl;
+
+            if (std::get<0>(executeCommand(command)) != 0) {
+                return std::nullopt;
+            }
+        }
+
+        std::string lsTree = "git -C " + index.string() + " ls-tree " + commit + " " + path;
+        auto [exit, output] = executeCommand(lsTree + " 2>/dev/null");
+
+        if (exit != 0 || output.empty()) {
+            std::string fetch = "git -C " + index.string() +
+                " fetch -q --depth 1 --filter=blob:none origin " + commit + " 2>&1";
+
+            executeCommand(fetch);
+            std::tie(exit, output) = executeCommand(lsTree + " 2>&1");
+        }
+
+        // <mode> commit <sha>\t<path>
+        std::istringstream entry = std::istringstream(output);
+        std::string mode, type, sha;
+
+        if (exit != 0 || !(entry >> mode >> type >> sha) || type != "commit") {
+            return std::nullopt;
+        }
+
+        return sha;
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    extractArchiveTree(const std::filesystem::path& tree, const std::string& commit,
+                       const std::string& archiveTemplate) {
+        auto result = extractArchive(archiveTemplate, getRepoName(c_hyprlandUrl), commit, tree);
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        for (const SSubmodule& submodule : readSubmodules(tree)) {
+            std::filesystem::path submodulePath = tree / submodule.m_sPath;
+
+            if (submodule.m_sPath.empty() || submodule.m_sUrl.empty()) {
+                continue;
+            }
+
+            // Archives built with their submodules, e.g. for offline use, are complete already
+            if (std::filesystem::exists(submodulePath) &&
+                !std::filesystem::is_empty(submodulePath)) {
+                if (std::optional<std::string> submoduleCommit =
+                        readArchivedSubmoduleCommit(tree, submodule.m_sPath)) {
+                    std::ofstream(submodulePath / c_archiveCommitFile, std::ios::trunc)
+                        << submoduleCommit.value() << std::endl;
+                }
+
+                continue;
+            }
+
+            std::optional<std::string> submoduleCommit =
+                getSubmoduleCommit(tree, commit, submodule.m_sPath);
+
+            if (!submoduleCommit.has_value()) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to find the commit of submodule " + submodule.m_sPath);
+            }
+
+            result = extractArchive(archiveTemplate, getRepoName(submodule.m_sUrl),
+                                    submoduleCommit.value(), submodulePath);
+
+            if (result.isErr()) {
+                return result;
+            }
+
+            // Minimal generation keys the submodule's generated headers on its commit, the
+            // same way as for the tree itself
+            std::ofstream(submodulePath / c_archiveCommitFile, std::ios::trunc)
+                << submoduleCommit.value() << std::endl;
+
+            if (getHeadersCommit(submodulePath) != submoduleCommit) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to record the commit of submodule " + submodule.m_sPath);
+            }
+        }
+
+        std::ofstream(tree / c_archiveCommitFile, std::ios::trunc) << commit << std::endl;
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    checkoutTree(const std::filesystem::path& tree, const std::string& commit) {
+        git::GitBackend& backend = git::getBackend();
+
+        if (!std::filesystem::exists(tree)) {
+            auto result = backend.clone(c_hyprlandUrl, "", tree, 1, true,
+                                        git::makeProgressReporter("Cloning Hyprland"));
+
+            if (result.isErr()) {
+                return result;
+            }
+        }
+
+        auto result = backend.fetch(tree, git::makeProgressReporter("Fetching Hyprland"));
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        return backend.checkout(tree, commit, true);
+    }
+
+    hyprload::Result<std::monostate, std::string> prepareTree(const std::filesystem::path& tree,
+                                                              const std::string& commit) {
+        std::optional<std::string> archiveTemplate = getHeadersArchiveTemplate();
+        bool extracted = getHeadersCommit(tree) == commit && !std::filesystem::exists(tree / ".git");
+        std::error_code ec;
+
+        if (!extracted && std::filesystem::exists(tree) && !std::filesystem::exists(tree / ".git")) {
+            // Left behind by an interrupted extraction
+            std::filesystem::remove_all(tree, ec);
+        }
+
+        if (!extracted && archiveTemplate.has_value() && !std::filesystem::exists(tree)) {
+            auto result = extractArchiveTree(tree, commit, archiveTemplate.value());
+
+            if (result.isOk()) {
+                extracted = true;
+            } else {
+                debug(result.unwrapErr() + ", falling back to git");
+
+                std::filesystem::remove_all(tree, ec);
+            }
+        }
+
+        if (!extracted) {
+            auto result = checkoutTree(tree, commit);
+
+            if (result.isErr()) {
+                return result;
+            }
+        }
+
+        if (isMinimalHeaders()) {
+            auto generateResult = generateHeaders(tree);
+
+            if (generateResult.isOk()) {
+                return generateResult;
+            }
+
+            // Extracted trees carry every commit minimal generation keys on, so this points
+            // at a broken archive rather than a missing tool
+            if (extracted && !std::filesystem::exists(tree / ".git")) {
+                debug("Minimal headers failed on an archive tree");
+            }
+
+            debug(generateResult.unwrapErr() + ", falling back to make pluginenv");
+        }
+
+        // Make pluginenv
+        std::string command = "make -C " + tree.string() + " pluginenv";
+
+        std::tuple<int, std::string> result = hyprload::executeCommand(command);
+
+        if (std::get<0>(result) != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to make pluginenv: " + std::get<1>(result));
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    setupLocalHeaders(const std::filesystem::path& tree, const std::string& commit) {
+        // Builds hold this shared, so the tree never changes under them
+        std::filesystem::path lockFile = getPathLockFile("headers", tree);
+        FileLock headersLock = FileLock(lockFile);
+
+        std::filesystem::path readyStamp = lockFile;
+        readyStamp.replace_extension(".ready");
+
+        // Another instance may have prepared the same commit while we waited
+        if (getHeadersCommit(tree) == commit) {
+            std::ifstream stamp = std::ifstream(readyStamp);
+            std::string preparedCommit;
+
+            if (std::getline(stamp, preparedCommit) && preparedCommit == commit) {
+                debug("Hyprland headers already prepared");
+
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            }
+        }
+
+        std::filesystem::remove(readyStamp);
+
+        auto result = prepareTree(tree, commit);
+
+        if (result.isOk()) {
+            std::ofstream(readyStamp, std::ios::trunc) << commit << std::endl;
+        }
+
+        return result;
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    setupSharedHeaders(const std::filesystem::path& sharedCache, const std::string& commit) {
+        std::filesystem::path tree = cache::getSharedHeadersPath(sharedCache, commit);
+        FileLock headersLock = FileLock(cache::getSharedLockPath(sharedCache, "headers." + commit));
+
+        if (std::filesystem::exists(tree)) {
+            debug("Using shared Hyprland headers for " + commit.substr(0, 7));
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        cache::createSharedDirectory(tree.parent_path());
+
+        std::filesystem::path stagingPath = tree;
+        stagingPath += ".tmp." + std::to_string(getpid());
+
+        std::error_code ec;
+        std::filesystem::remove_all(stagingPath, ec);
+
+        auto result = prepareTree(stagingPath, commit);
+
+        if (result.isOk()) {
+            // Everything git and make created must stay usable by the rest of the group
+            executeCommand("chmod -R g+rwX " + stagingPath.string());
+
+            std::filesystem::rename(stagingPath, tree, ec);
+
+            if (ec) {
+                result = hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to publish shared headers: " + ec.message());
+            }
+        }
+
+        if (result.isErr()) {
+            std::filesystem::remove_all(stagingPath, ec);
+        }
+
+        return result;
+    }
+}
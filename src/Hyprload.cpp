@@ -5,24 +5,48 @@
 #include "Hyprload.hpp"
 #include "HyprloadConfig.hpp"
 #include "HyprloadOverlay.hpp"
+#include "BuildEnvironment.hpp"
+#include "Compression.hpp"
+#include "ElfScanner.hpp"
+#include "Pipeline.hpp"
+#include "Pgo.hpp"
+#include "Headers.hpp"
+#include "PowerPolicy.hpp"
+#include "SystemMonitor.hpp"
+#include "UpdateChecker.hpp"
 
 #include <src/helpers/Monitor.hpp>
+#include <src/managers/KeybindManager.hpp>
 #include <src/plugins/PluginSystem.hpp>
 #include <src/config/ConfigManager.hpp>
 #include <src/plugins/PluginAPI.hpp>
 
+#include <chrono>
+#include <ctime>
+#include <fstream>
 #include <thread>
 #include <random>
-#include <condition_variable>
 #include <mutex>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
+#include <unistd.h>
+
 namespace hyprload {
     std::mutex g_mSetupHeadersMutex;
-    std::condition_variable g_cvSetupHeaders;
     std::optional<hyprload::Result<std::monostate, std::string>> g_bHeadersReady = std::nullopt;
 
+    void setHeadersReady(hyprload::Result<std::monostate, std::string>&& result) {
+        {
+            auto headerLock = std::scoped_lock<std::mutex>(g_mSetupHeadersMutex);
+            g_bHeadersReady = std::move(result);
+        }
+
+        // Jobs parked in WAIT_HEADERS can continue now
+        pipeline::g_pExecutor->wake();
+    }
+
     Hyprload::Hyprload() {
         m_sSessionGuid = std::nullopt;
         m_vPlugins = std::vector<std::string>();
@@ -30,6 +54,69 @@ namespace hyprload {
     }
 
     void Hyprload::handleTick() {
+        if (m_pGarbageCollector && m_pGarbageCollector->m_mMutex.try_lock()) {
+            auto result = m_pGarbageCollector->m_rResult;
+            m_pGarbageCollector->m_mMutex.unlock();
+
+            if (result.has_value()) {
+                if (result.value().isErr()) {
+                    error(result.value().unwrapErr());
+                } else {
+                    gc::SGcStats stats = result.value().unwrap();
+
+                    success("Freed " + std::to_string(stats.m_iBytesFreed / (1024 * 1024)) +
+                            " MiB, " + std::to_string(stats.m_iBytesRemaining / (1024 * 1024)) +
+                            " MiB in use");
+                }
+
+                m_pGarbageCollector = nullptr;
+
+                startQueuedRun();
+            }
+        }
+
+        if (m_pUpdateCheck && m_pUpdateCheck->m_mMutex.try_lock()) {
+            auto result = m_pUpdateCheck->m_iResult;
+            m_pUpdateCheck->m_mMutex.unlock();
+
+            if (result.has_value()) {
+                if (result.value() > 0) {
+                    info(std::to_string(result.value()) + " plugin updates available");
+                }
+
+                m_pUpdateCheck = nullptr;
+            }
+        }
+
+        if (m_pMaintenance && m_pMaintenance->m_mMutex.try_lock()) {
+            auto result = m_pMaintenance->m_rResult;
+            m_pMaintenance->m_mMutex.unlock();
+
+            if (result.has_value()) {
+                maintenance::SMaintenanceStats stats = result.value().unwrap();
+
+                debug("Maintained " + std::to_string(stats.m_iMaintained) + " repositories, " +
+                      std::to_string(stats.m_iSkipped) + " skipped" +
+                      (stats.m_bTimedOut ? ", stopped at the time limit" : ""));
+
+                m_pMaintenance = nullptr;
+            }
+        }
+
+        if (power::g_pPowerPolicy->poll()) {
+            applyPowerPolicy();
+        }
+
+        loadPreloadedPlugins();
+        runLazyDispatches();
+        unloadIdlePlugins();
+        collectProfiles();
+
+        scheduleUpdateCheck();
+        scheduleMaintenance();
+
+        pipeline::g_pExecutor->runMainThreadTasks();
+
         if (!m_bIsBuilding) {
             return;
         }
@@ -38,8 +125,27 @@ namespace hyprload {
         for (auto bp : buildProcesses) {
             if (bp->m_mMutex.try_lock()) {
                 if (bp->m_rResult.has_value()) {
-                    if (bp->m_rResult.value().isErr()) {
-                        error(bp->m_rResult.value().unwrapErr());
+                    auto result = bp->m_rResult.value();
+
+                    // A failed optimized build never reaches its LOAD stage, so the instrumented
+                    // binary unloaded for it comes back right away
+                    if (m_sProfileRebuilds.erase(bp->m_sName) > 0 && result.isErr()) {
+                        m_sFailedCollections.insert(getBinaryName(bp->m_sName));
+
+                        if (isStreamingReload()) {
+                            auto reloadResult = reloadPlugin(bp->m_sName);
+
+                            if (reloadResult.isErr()) {
+                                error("Failed to reload " + bp->m_sName + ": " +
+                                      reloadResult.unwrapErr());
+                            }
+                        }
+                    }
+
+                    if (result.isErr()) {
+                        error(result.unwrapErr());
+                    } else if (result.unwrap() == pipeline::eOutcome::UP_TO_DATE) {
+                        info(bp->m_sName + " is up to date");
                     } else {
                         success("Successfully updated " + bp->m_sName);
                     }
@@ -55,330 +161,434 @@ namespace hyprload {
 
         if (m_vBuildProcesses.empty()) {
             m_bIsBuilding = false;
-            success("Finished updating all plugins");
+            m_sCurrentRunPlugins.clear();
 
-            reloadPlugins();
+            if (isStreamingReload()) {
+                success("Finished updating all plugins, reloaded " +
+                        std::to_string(m_iStreamedReloads) + " of them");
+            } else {
+                success("Finished updating all plugins");
+            }
+
+            // Reload once after the last queued run, not after each of them
+            if (startQueuedRun()) {
+                return;
+            }
+
+            finishRuns();
         }
     }
 
-    void Hyprload::installPlugins() {
-        if (m_bIsBuilding) {
-            error("Already updating plugins");
-            return;
+    void Hyprload::finishRuns() {
+        if (!isStreamingReload() || m_bReloadQueued) {
+            m_bReloadQueued = false;
+
+            reloadPlugins();
         }
 
-        m_bIsBuilding = true;
+        collectGarbage(true);
+    }
 
-        std::optional<std::filesystem::path> configHyprlandHeadersPath =
-            hyprload::getConfigHyprlandHeadersPath();
+    void Hyprload::installPlugins(const std::optional<std::string>& name) {
+        requestRun(false, name);
+    }
 
-        if (!configHyprlandHeadersPath.has_value()) {
-            setupHeaders();
-        } else {
-            g_bHeadersReady = hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    void Hyprload::updatePlugins(const std::optional<std::string>& name) {
+        requestRun(true, name);
+    }
+
+    void Hyprload::requestRun(bool update, const std::optional<std::string>& name) {
+        if (!m_bIsBuilding && !m_pGarbageCollector) {
+            SQueuedRun run;
+            run.m_bUpdate = update;
+            run.m_bAllPlugins = !name.has_value();
+
+            if (name.has_value()) {
+                run.m_sPlugins.insert(name.value());
+            }
+
+            runPipelines(run);
+            return;
         }
 
-        std::filesystem::path hyprlandHeadersPath = getHyprlandHeadersPath();
+        std::vector<std::string> requested = std::vector<std::string>();
 
         config::g_pHyprloadConfig->reloadConfig();
 
-        const std::vector<plugin::PluginRequirement>& requirements =
-            config::g_pHyprloadConfig->getPlugins();
+        if (name.has_value()) {
+            const std::vector<plugin::PluginRequirement>& requirements =
+                config::g_pHyprloadConfig->getPlugins();
+
+            // Reported now, a queued run of nothing would never get to reloading afterwards
+            if (!(name.value() == "hyprload" && update) &&
+                std::none_of(requirements.begin(), requirements.end(),
+                             [&name](const plugin::PluginRequirement& requirement) {
+                                 return requirement.getName() == name.value();
+                             })) {
+                error(name.value() + " is not in " + config::getConfigPath().string());
+                return;
+            }
 
-        for (const plugin::PluginRequirement& plugin : requirements) {
-            std::shared_ptr<hyprload::BuildProcessDescriptor> descriptor =
-                std::make_shared<hyprload::BuildProcessDescriptor>(
-                    std::string(plugin.getName()), plugin.getSource(), hyprlandHeadersPath);
+            requested.push_back(name.value());
+        } else {
+            for (const plugin::PluginRequirement& plugin :
+                 config::g_pHyprloadConfig->getPlugins()) {
+                requested.push_back(std::string(plugin.getName()));
+            }
 
-            auto myDescriptor = descriptor;
-            m_vBuildProcesses.push_back(myDescriptor);
+            if (update) {
+                requested.push_back("hyprload");
+            }
+        }
 
-            std::thread thread = std::thread([descriptor]() {
-                std::unique_lock<std::mutex> headerLock = std::unique_lock(g_mSetupHeadersMutex);
-                g_cvSetupHeaders.wait(headerLock, []() { return g_bHeadersReady.has_value(); });
+        std::vector<std::string> uncovered = std::vector<std::string>();
 
-                if (g_bHeadersReady.value().isOk()) {
-                    headerLock.unlock();
-                } else {
-                    auto lock = std::unique_lock<std::mutex>(descriptor->m_mMutex);
+        for (const std::string& plugin : requested) {
+            if (!m_bIsBuilding || !isCoveredByCurrentRun(update, plugin)) {
+                uncovered.push_back(plugin);
+            }
+        }
 
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to setup Hyprland headers");
-                    return;
-                }
+        if (uncovered.empty()) {
+            info("Already " + std::string(update ? "updating " : "installing ") +
+                 name.value_or("all plugins"));
+            return;
+        }
 
-                auto source = descriptor->m_pSource;
+        std::optional<SQueuedRun>& queuedRun = update ? m_sQueuedUpdate : m_sQueuedInstall;
 
-                if (!source->isSourceAvailable()) {
-                    auto result = source->installSource();
+        if (!queuedRun.has_value()) {
+            queuedRun = SQueuedRun();
+        }
 
-                    if (result.isErr()) {
-                        auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        SQueuedRun& run = queuedRun.value();
 
-                        descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                            "Failed to install " + descriptor->m_sName +
-                            " source: " + result.unwrapErr());
-                        return;
-                    }
-                }
+        run.m_bUpdate = update;
 
-                auto result =
-                    source->build(descriptor->m_sName, descriptor->m_sHyprlandHeadersPath);
+        if (!name.has_value() && uncovered.size() == requested.size()) {
+            run.m_bAllPlugins = true;
+        } else {
+            run.m_sPlugins.insert(uncovered.begin(), uncovered.end());
+        }
 
-                if (result.isErr()) {
-                    auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        info("Queued " + std::string(update ? "update" : "install") + " of " +
+             (name.has_value() ? name.value() : std::to_string(uncovered.size()) + " plugins") +
+             " until the current run finishes");
+    }
 
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to build " + descriptor->m_sName + ": " + result.unwrapErr());
-                    return;
-                }
+    bool Hyprload::isCoveredByCurrentRun(bool update, const std::string& name) const {
+        if (!m_sCurrentRunPlugins.contains(name)) {
+            return false;
+        }
 
-                auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        // Installing builds whatever source is on disk, which the current run already does
+        if (!update) {
+            return true;
+        }
 
-                descriptor->m_rResult =
-                    hyprload::Result<std::monostate, std::string>::ok(std::monostate());
-            });
+        if (!m_bCurrentRunIsUpdate) {
+            return false;
+        }
+
+        // An update is only served if the source has not been fetched yet, otherwise the
+        // caller might be waiting on a commit pushed after that fetch
+        for (const std::shared_ptr<BuildProcessDescriptor>& bp : m_vBuildProcesses) {
+            if (bp->m_sName != name) {
+                continue;
+            }
+
+            auto lock = std::scoped_lock<std::mutex>(bp->m_mMutex);
 
-            thread.detach();
+            return !bp->m_rResult.has_value() && bp->m_eStage <= pipeline::eStage::FETCH;
         }
+
+        return false;
     }
 
-    void Hyprload::updatePlugins() {
-        if (m_bIsBuilding) {
-            error("Already updating plugins");
-            return;
+    bool Hyprload::startQueuedRun() {
+        if (m_bIsBuilding || m_pGarbageCollector) {
+            return false;
         }
 
-        m_bIsBuilding = true;
+        for (std::optional<SQueuedRun>* queuedRun : {&m_sQueuedUpdate, &m_sQueuedInstall}) {
+            if (!queuedRun->has_value()) {
+                continue;
+            }
 
-        std::optional<std::filesystem::path> configHyprlandHeadersPath =
-            hyprload::getConfigHyprlandHeadersPath();
+            SQueuedRun run = std::move(queuedRun->value());
+            *queuedRun = std::nullopt;
 
-        if (!configHyprlandHeadersPath.has_value()) {
-            setupHeaders();
-        } else {
-            g_bHeadersReady = hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            if (runPipelines(run)) {
+                return true;
+            }
         }
 
-        std::filesystem::path hyprlandHeadersPath = getHyprlandHeadersPath();
-
-        // update self
+        return false;
+    }
 
-        std::shared_ptr<hyprload::BuildProcessDescriptor> descriptor =
-            std::make_shared<hyprload::BuildProcessDescriptor>(
-                "hyprload", std::make_shared<plugin::SelfSource>(), hyprlandHeadersPath);
+    bool Hyprload::runPipelines(const SQueuedRun& run) {
+        bool update = run.m_bUpdate;
 
-        auto myDescriptor = descriptor;
-        m_vBuildProcesses.push_back(myDescriptor);
+        config::g_pHyprloadConfig->reloadConfig();
 
-        std::thread thread = std::thread([descriptor]() {
-            std::unique_lock<std::mutex> headerLock = std::unique_lock(g_mSetupHeadersMutex);
-            g_cvSetupHeaders.wait(headerLock, []() { return g_bHeadersReady.has_value(); });
+        const std::vector<plugin::PluginRequirement>& requirements =
+            config::g_pHyprloadConfig->getPlugins();
 
-            if (g_bHeadersReady.value().isOk()) {
-                headerLock.unlock();
-            } else {
-                auto lock = std::unique_lock<std::mutex>(descriptor->m_mMutex);
+        bool updateSelf = update && (run.m_bAllPlugins || run.m_sPlugins.contains("hyprload"));
+        std::vector<const plugin::PluginRequirement*> selected =
+            std::vector<const plugin::PluginRequirement*>();
 
-                descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                    "Failed to setup Hyprland headers");
-                return;
+        for (const plugin::PluginRequirement& plugin : requirements) {
+            if (run.m_bAllPlugins || run.m_sPlugins.contains(std::string(plugin.getName()))) {
+                selected.push_back(&plugin);
             }
+        }
 
-            auto source = descriptor->m_pSource;
-
-            if (!source->isSourceAvailable()) {
-                auto result = source->installSource();
+        for (const std::string& name : run.m_sPlugins) {
+            bool required = name == "hyprload" && update;
 
-                if (result.isErr()) {
-                    auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+            for (const plugin::PluginRequirement* plugin : selected) {
+                required = required || plugin->getName() == name;
+            }
 
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to install " + descriptor->m_sName +
-                        " source: " + result.unwrapErr());
-                    return;
-                }
+            if (!required) {
+                error(name + " is not in " + config::getConfigPath().string());
             }
+        }
 
-            if (source->isUpToDate()) {
-                auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        if (!updateSelf && selected.empty()) {
+            return false;
+        }
 
-                descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                    "Source is up to date, skipping update...");
-                return;
-            }
+        plugin::startRun();
 
-            auto result = source->update(descriptor->m_sName, descriptor->m_sHyprlandHeadersPath);
+        m_bIsBuilding = true;
+        m_bCurrentRunIsUpdate = update;
+        m_iStreamedReloads = 0;
 
-            if (result.isErr()) {
-                auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        pipeline::g_pExecutor->setResourceLimit(pipeline::eResource::NETWORK, getNetworkJobs());
+        pipeline::g_pExecutor->setResourceLimit(pipeline::eResource::CPU, getBuildSlots());
 
-                descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                    "Failed to build " + descriptor->m_sName + ": " + result.unwrapErr());
-                return;
-            }
+        std::optional<std::filesystem::path> configHyprlandHeadersPath =
+            hyprload::getConfigHyprlandHeadersPath();
+
+        if (!configHyprlandHeadersPath.has_value()) {
+            setupHeaders();
+        } else {
+            setHeadersReady(hyprload::Result<std::monostate, std::string>::ok(std::monostate()));
+        }
 
-            auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+        std::filesystem::path hyprlandHeadersPath = getHyprlandHeadersPath();
 
-            descriptor->m_rResult =
-                hyprload::Result<std::monostate, std::string>::ok(std::monostate());
-        });
+        if (updateSelf) {
+            std::shared_ptr<hyprload::BuildProcessDescriptor> descriptor =
+                std::make_shared<hyprload::BuildProcessDescriptor>(
+                    "hyprload", std::make_shared<plugin::SelfSource>(), hyprlandHeadersPath);
 
-        thread.detach();
+            m_vBuildProcesses.push_back(descriptor);
+            m_sCurrentRunPlugins.insert(descriptor->m_sName);
+            pipeline::g_pExecutor->submit(createPipeline(true, false), descriptor);
+        }
 
-        config::g_pHyprloadConfig->reloadConfig();
+        std::shared_ptr<const pipeline::Pipeline> pluginPipeline =
+            createPipeline(update, isStreamingReload());
 
-        const std::vector<plugin::PluginRequirement>& requirements =
-            config::g_pHyprloadConfig->getPlugins();
+        for (const plugin::PluginRequirement* plugin : selected) {
+            build::setPluginToolchain(plugin->getName(), resolveToolchain(*plugin, true));
 
-        for (const plugin::PluginRequirement& plugin : requirements) {
             std::shared_ptr<hyprload::BuildProcessDescriptor> descriptor =
                 std::make_shared<hyprload::BuildProcessDescriptor>(
-                    std::string(plugin.getName()), plugin.getSource(), hyprlandHeadersPath);
+                    std::string(plugin->getName()), plugin->getSource(), hyprlandHeadersPath);
+
+            m_vBuildProcesses.push_back(descriptor);
+            m_sCurrentRunPlugins.insert(descriptor->m_sName);
+            pipeline::g_pExecutor->submit(pluginPipeline, descriptor);
+        }
 
-            auto myDescriptor = descriptor;
-            m_vBuildProcesses.push_back(myDescriptor);
+        return true;
+    }
 
-            std::thread thread = std::thread([descriptor]() {
-                std::unique_lock<std::mutex> headerLock = std::unique_lock(g_mSetupHeadersMutex);
-                g_cvSetupHeaders.wait(headerLock, []() { return g_bHeadersReady.has_value(); });
+    std::shared_ptr<const pipeline::Pipeline> Hyprload::createPipeline(bool update, bool load) {
+        using pipeline::eResource;
+        using pipeline::eStage;
+        using pipeline::eStageFlow;
+        using pipeline::StageResult;
 
-                if (g_bHeadersReady.value().isOk()) {
-                    headerLock.unlock();
-                } else {
-                    auto lock = std::unique_lock<std::mutex>(descriptor->m_mMutex);
+        std::shared_ptr<pipeline::Pipeline> pluginPipeline = std::make_shared<pipeline::Pipeline>();
 
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to setup Hyprland headers");
-                    return;
-                }
+        if (update) {
+            pluginPipeline->addStage(
+                eStage::RESOLVE, eResource::NETWORK,
+                [](BuildProcessDescriptor& descriptor) -> StageResult {
+                    auto source = descriptor.m_pSource;
 
-                auto source = descriptor->m_pSource;
+                    // A source that still has to be cloned is never up to date
+                    if (!source->isSourceAvailable()) {
+                        return StageResult::ok(eStageFlow::NEXT);
+                    }
+
+                    std::optional<std::string> revision = source->getRevision();
+
+                    if (!revision.has_value()) {
+                        return StageResult::ok(source->isUpToDate() ? eStageFlow::UP_TO_DATE :
+                                                                      eStageFlow::NEXT);
+                    }
+
+                    // A background check within the interval stands in for asking the remote
+                    std::optional<std::string> remote =
+                        updates::g_pUpdateCache->getFreshRemoteRevision(descriptor.m_sName);
+
+                    if (!remote.has_value()) {
+                        remote = source->getRemoteRevision();
+
+                        if (remote.has_value()) {
+                            updates::g_pUpdateCache->recordCheck(
+                                descriptor.m_sName,
+                                updates::SRevisionCheck{std::time(nullptr), revision.value(),
+                                                        remote.value()});
+                        }
+                    }
+
+                    if (remote == revision) {
+                        return StageResult::ok(eStageFlow::UP_TO_DATE);
+                    }
+
+                    return StageResult::ok(eStageFlow::NEXT);
+                });
+        }
+
+        pluginPipeline->addStage(
+            eStage::FETCH, eResource::NETWORK,
+            [update](BuildProcessDescriptor& descriptor) -> StageResult {
+                auto source = descriptor.m_pSource;
 
                 if (!source->isSourceAvailable()) {
                     auto result = source->installSource();
 
                     if (result.isErr()) {
-                        auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+                        return StageResult::err(result.unwrapErr());
+                    }
+                } else if (update) {
+                    auto result = source->pullSource();
 
-                        descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                            "Failed to install " + descriptor->m_sName +
-                            " source: " + result.unwrapErr());
-                        return;
+                    if (result.isErr()) {
+                        return StageResult::err(result.unwrapErr());
                     }
                 }
 
-                if (source->isUpToDate()) {
-                    auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
+                if (std::optional<std::string> revision = source->getRevision()) {
+                    updates::g_pUpdateCache->recordRevision(descriptor.m_sName, revision.value());
+                }
 
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Source is up to date, skipping update...");
-                    return;
+                if (!std::dynamic_pointer_cast<plugin::SelfSource>(source) &&
+                    !source->providesPlugin(descriptor.m_sName)) {
+                    return StageResult::err("Source does not provide " + descriptor.m_sName);
                 }
 
+                return StageResult::ok(eStageFlow::NEXT);
+            });
+
+        // Fetching does not need headers, only building waits for them
+        pluginPipeline->addStage(eStage::WAIT_HEADERS, eResource::NONE,
+                                 [](BuildProcessDescriptor&) -> StageResult {
+                                     auto headerLock =
+                                         std::scoped_lock<std::mutex>(g_mSetupHeadersMutex);
+
+                                     if (!g_bHeadersReady.has_value()) {
+                                         return StageResult::ok(eStageFlow::PENDING);
+                                     }
+
+                                     if (g_bHeadersReady.value().isErr()) {
+                                         return StageResult::err(
+                                             g_bHeadersReady.value().unwrapErr());
+                                     }
+
+                                     return StageResult::ok(eStageFlow::NEXT);
+                                 });
+
+        pluginPipeline->addStage(
+            eStage::BUILD, eResource::CPU, [](BuildProcessDescriptor& descriptor) -> StageResult {
                 auto result =
-                    source->update(descriptor->m_sName, descriptor->m_sHyprlandHeadersPath);
+                    descriptor.m_pSource->build(descriptor.m_sName, descriptor.m_sHyprlandHeadersPath);
 
                 if (result.isErr()) {
-                    auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
-
-                    descriptor->m_rResult = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to update " + descriptor->m_sName + ": " + result.unwrapErr());
-                    return;
+                    return StageResult::err(result.unwrapErr());
                 }
-                auto lock = std::scoped_lock<std::mutex>(descriptor->m_mMutex);
 
-                descriptor->m_rResult =
-                    hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+                return StageResult::ok(eStageFlow::NEXT);
             });
 
-            thread.detach();
-        }
-    }
+        pluginPipeline->addStage(
+            eStage::INSTALL, eResource::NONE, [](BuildProcessDescriptor& descriptor) -> StageResult {
+                auto result = descriptor.m_pSource->deploy(descriptor.m_sName,
+                                                           descriptor.m_sHyprlandHeadersPath);
 
-    void Hyprload::setupHeaders() {
-        std::string hyprlandVersion = HyprlandAPI::invokeHyprctlCommand("version", {}, "j");
-        debug("Hyprland version: " + hyprlandVersion);
+                if (result.isErr()) {
+                    return StageResult::err(result.unwrapErr());
+                }
 
-        usize hyprlandVersionStart = hyprlandVersion.find("\"commit\": \"");
-        if (hyprlandVersionStart == std::string::npos) {
-            error("Failed to find commit hash in Hyprland version");
-            return;
-        }
-        std::string commitHash = hyprlandVersion.substr(hyprlandVersionStart + 11, 40);
+                return StageResult::ok(eStageFlow::NEXT);
+            });
 
-        debug("Hyprland commit hash: " + commitHash);
+        // Swap this plugin in right away instead of waiting for the rest
+        if (load) {
+            pluginPipeline->addStage(
+                eStage::LOAD, eResource::MAIN_THREAD,
+                [this](BuildProcessDescriptor& descriptor) -> StageResult {
+                    auto result = reloadPlugin(descriptor.m_sName);
 
-        std::thread thread = std::thread([commitHash]() {
-            std::unique_lock<std::mutex> headerLock = std::unique_lock(g_mSetupHeadersMutex);
+                    if (result.isErr()) {
+                        return StageResult::err(result.unwrapErr());
+                    }
 
-            std::optional<std::filesystem::path> configHyprlandHeadersPath =
-                hyprload::getConfigHyprlandHeadersPath();
+                    m_iStreamedReloads++;
 
-            if (configHyprlandHeadersPath.has_value()) {
-                g_bHeadersReady =
-                    hyprload::Result<std::monostate, std::string>::ok(std::monostate());
-                headerLock.unlock();
-                g_cvSetupHeaders.notify_all();
-                return;
-            }
+                    return StageResult::ok(eStageFlow::NEXT);
+                });
+        }
 
-            std::filesystem::path hyprlandHeadersPath = hyprload::getHyprlandHeadersPath();
+        return pluginPipeline;
+    }
 
-            if (!std::filesystem::exists(hyprlandHeadersPath)) {
-                // Clone hyprland
+    void Hyprload::setupHeaders() {
+        {
+            auto headerLock = std::scoped_lock<std::mutex>(g_mSetupHeadersMutex);
 
-                const std::string hyprlandUrl = "https://github.com/hyprwm/Hyprland.git";
+            // A run that finished early left the previous setup going, its result still serves
+            if (m_tHeadersThread.joinable() && !g_bHeadersReady.has_value()) {
+                return;
+            }
 
-                std::string command = "git clone " + hyprlandUrl + " " +
-                    hyprlandHeadersPath.string() + " --recurse-submodules --depth 1";
+            g_bHeadersReady = std::nullopt;
+        }
 
-                std::tuple<int, std::string> result = hyprload::executeCommand(command);
+        std::optional<std::string> hyprlandCommit = getHyprlandCommit();
 
-                if (std::get<0>(result) != 0) {
-                    g_bHeadersReady = hyprload::Result<std::monostate, std::string>::err(
-                        "Failed to clone Hyprland: " + std::get<1>(result));
-                    headerLock.unlock();
-                    g_cvSetupHeaders.notify_all();
-                    return;
-                }
-            }
+        if (!hyprlandCommit.has_value()) {
+            error("Failed to find commit hash in Hyprland version");
 
-            // Checkout to commit hash
-            std::string command = "git -C " + hyprlandHeadersPath.string() + " fetch && git -C " +
-                hyprlandHeadersPath.string() + " checkout " + commitHash + " --recurse-submodules";
+            setHeadersReady(hyprload::Result<std::monostate, std::string>::err(
+                "Failed to find commit hash in Hyprland version"));
+            return;
+        }
 
-            std::tuple<int, std::string> result = hyprload::executeCommand(command);
+        std::string commitHash = hyprlandCommit.value();
 
-            if (std::get<0>(result) != 0) {
-                g_bHeadersReady = hyprload::Result<std::monostate, std::string>::err(
-                    "Failed to checkout to commit hash: " + std::get<1>(result));
-                headerLock.unlock();
-                g_cvSetupHeaders.notify_all();
-                return;
-            }
+        debug("Hyprland commit hash: " + commitHash);
 
-            // Make pluginenv
-            command = "make -C " + hyprlandHeadersPath.string() + " pluginenv";
+        startThread(m_tHeadersThread, [commitHash]() {
+            std::optional<std::filesystem::path> sharedCache = getSharedCachePath();
 
-            result = hyprload::executeCommand(command);
+            auto result = sharedCache.has_value()
+                ? headers::setupSharedHeaders(sharedCache.value(), commitHash)
+                : headers::setupLocalHeaders(getHyprlandHeadersPath(), commitHash);
 
-            if (std::get<0>(result) != 0) {
-                g_bHeadersReady = hyprload::Result<std::monostate, std::string>::err(
-                    "Failed to make pluginenv: " + std::get<1>(result));
-                headerLock.unlock();
-                g_cvSetupHeaders.notify_all();
-                return;
+            if (result.isOk()) {
+                debug("Hyprland headers ready");
             }
 
-            debug("Hyprland headers ready");
-
-            g_bHeadersReady = hyprload::Result<std::monostate, std::string>::ok(std::monostate());
-            headerLock.unlock();
-            g_cvSetupHeaders.notify_all();
+            setHeadersReady(std::move(result));
         });
-
-        thread.detach();
     }
 
     void Hyprload::loadPlugins() {
@@ -409,6 +619,13 @@ namespace hyprload {
 
         std::filesystem::create_directories(sessionPluginPath);
 
+        // Stripped binaries point at their debug info through .gnu_debuglink, which debuggers
+        // resolve relative to the loaded binary
+        if (std::filesystem::exists(getPluginDebugInfoPath())) {
+            std::filesystem::create_directory_symlink(getPluginDebugInfoPath(),
+                                                      sessionPluginPath / ".debug");
+        }
+
         debug("Creating lock file...");
 
         if (!lockSession()) {
@@ -421,108 +638,1367 @@ namespace hyprload {
         debug("Copying plugins...");
 
         std::vector<std::string> pluginFiles = std::vector<std::string>();
+        std::unordered_map<std::string, std::filesystem::path> stagedPaths =
+            std::unordered_map<std::string, std::filesystem::path>();
+        std::vector<std::filesystem::path> compressedFiles = std::vector<std::filesystem::path>();
 
         for (const auto& entry : std::filesystem::directory_iterator(sourcePluginPath)) {
             std::string filename = entry.path().filename();
-            if (filename.find(".so") != std::string::npos) {
+            if (entry.path().extension() == ".so") {
                 debug("Discovered plugin: " + filename);
 
                 pluginFiles.push_back(filename);
+                stagedPaths[filename] = sessionPluginPath / filename;
 
                 debug("Copying plugin: " + entry.path().string() + " to " +
                       (sessionPluginPath / filename).string());
                 std::filesystem::copy(entry.path(), sessionPluginPath / filename);
-            }
-        }
-
-        for (auto& plugin : pluginFiles) {
-            info("Loading plugin: " + plugin);
+            } else if (compression::isCompressed(entry.path()) &&
+                       entry.path().stem().extension() == ".so") {
+                std::string plugin = entry.path().stem();
 
-            std::string pluginPath = sessionPluginPath / plugin;
+                // An install in progress may briefly leave both, the uncompressed one wins
+                if (std::filesystem::exists(sourcePluginPath / plugin) || !shouldLoad(plugin)) {
+                    continue;
+                }
 
-            HyprlandAPI::invokeHyprctlCommand("plugin", "load " + pluginPath);
+                debug("Discovered compressed plugin: " + filename);
 
-            m_vPlugins.push_back(plugin);
+                compressedFiles.push_back(entry.path());
+            }
         }
-    }
 
-    void Hyprload::clearPlugins() {
-        if (!m_sSessionGuid.has_value()) {
-            debug("Session guid does not exist, will not clear plugins...");
-            return;
-        }
+        std::vector<preload::SPreloadRequest> preloads = std::vector<preload::SPreloadRequest>();
 
-        std::filesystem::path sessionPluginPath = getSessionBinariesPath().value();
-        std::vector<CPlugin*> plugins = g_pPluginSystem->getAllPlugins();
+        // Decompressed and checked in parallel on the executor, loadPreloadedPlugins() stubs the
+        // lazy ones afterwards
+        for (const std::filesystem::path& compressedFile : compressedFiles) {
+            std::string plugin = compressedFile.stem();
+            const plugin::PluginRequirement* requirement = findRequirement(plugin);
 
-        debug("Plugin count: " + std::to_string(plugins.size()));
+            preloads.push_back(preload::SPreloadRequest{plugin, compressedFile,
+                                                        !requirement || !requirement->isLazy()});
+            m_mPreloading[plugin] = compressedFile;
+        }
 
-        std::vector<std::string> pluginFiles = std::vector<std::string>();
+        for (auto& plugin : pluginFiles) {
+            std::filesystem::path pluginPath = stagedPaths[plugin];
 
-        for (auto& plugin : m_vPlugins) {
-            info("Unloading plugin: " + plugin);
+            if (!shouldLoad(plugin)) {
+                debug("Not loading " + plugin + ", it is outside the profile or power hungry");
+                continue;
+            }
 
-            std::string pluginPath = sessionPluginPath / plugin;
+            auto preflight = preflightCheck(pluginPath);
 
-            if (std::none_of(plugins.begin(), plugins.end(), [&pluginPath](CPlugin* plugin) {
-                    return plugin->path == pluginPath;
-                })) {
-                debug("Plugin not found in plugin system, likely already unloaded, skipping "
-                      "unload...");
+            if (preflight.isErr()) {
+                error("Refusing to load " + plugin + ": " + preflight.unwrapErr());
+                releaseMemoryFile(pluginPath);
+                m_vRefusedPlugins.push_back(plugin);
+                continue;
+            }
+
+            if (stubLazyPlugin(plugin, pluginPath)) {
+                info("Deferring plugin until first use: " + plugin);
                 continue;
             }
 
-            pluginFiles.push_back(plugin);
+            preloads.push_back(preload::SPreloadRequest{plugin, pluginPath});
+            m_mPreloading[plugin] = pluginPath;
         }
 
-        for (auto& plugin : pluginFiles) {
-            HyprlandAPI::invokeHyprctlCommand("plugin", "unload " + plugin);
+        // Mapping and relocating happen on a worker, handleTick() loads each binary once ready
+        if (!preloads.empty()) {
+            m_bLoadingPlugins = true;
+            m_pPreloader = std::make_shared<preload::Preloader>(std::move(preloads),
+                                                                getPreflightCheck(),
+                                                                sessionPluginPath);
+            m_pPreloader->start();
+        } else {
+            success("Plugins loaded!");
         }
 
-        cleanupPlugin();
+        rebuildRefusedPlugins();
     }
 
-    void Hyprload::cleanupPlugin() {
-        std::filesystem::path sessionPluginPath = getSessionBinariesPath().value();
-        std::filesystem::path pluginBinariesPath = getPluginBinariesPath();
+    void Hyprload::rebuildRefusedPlugins() {
+        // Still checking compressed binaries, which may add to them
+        if (m_pPreloader) {
+            return;
+        }
 
-        m_vPlugins.clear();
+        std::vector<std::string> refused = std::move(m_vRefusedPlugins);
+        m_vRefusedPlugins = std::vector<std::string>();
 
-        debug("Removing lock file...");
+        // Only rebuild once, if the rebuilt binaries are still incompatible the headers or
+        // the plugin itself need fixing and rebuilding again would loop
+        if (refused.empty() || m_bIsBuilding || m_bPreflightRebuildScheduled) {
+            return;
+        }
 
-        unlockSession();
+        m_bPreflightRebuildScheduled = true;
 
-        std::filesystem::remove_all(sessionPluginPath);
+        SQueuedRun run;
 
-        const std::vector<plugin::PluginRequirement>& requirements =
-            config::g_pHyprloadConfig->getPlugins();
+        // Their revision and headers commit are unchanged, so the keys would skip the build
+        for (const std::string& plugin : refused) {
+            plugin::forgetInstalledBuild(getPluginBinariesPath() / plugin);
 
-        for (auto& entry : std::filesystem::directory_iterator(pluginBinariesPath)) {
-            std::string filename = entry.path().filename();
-            if (filename.find(".so") != std::string::npos) {
-                std::string pluginName = filename.substr(0, filename.find(".so"));
+            if (const plugin::PluginRequirement* requirement = findRequirement(plugin)) {
+                run.m_sPlugins.insert(requirement->getName());
+            }
+        }
+
+        if (run.m_sPlugins.empty()) {
+            return;
+        }
+
+        info("Rebuilding " + std::to_string(run.m_sPlugins.size()) + " incompatible plugins...");
+
+        // Only the refused plugins, merged into a pending install if gc holds up the run
+        if (!m_pGarbageCollector) {
+            runPipelines(run);
+        } else if (m_sQueuedInstall.has_value()) {
+            m_sQueuedInstall->m_sPlugins.insert(run.m_sPlugins.begin(), run.m_sPlugins.end());
+        } else {
+            m_sQueuedInstall = std::move(run);
+        }
+    }
+
+    void Hyprload::clearPlugins() {
+        if (!m_sSessionGuid.has_value()) {
+            debug("Session guid does not exist, will not clear plugins...");
+            return;
+        }
+
+        std::unordered_map<std::string, CPlugin*> loadedPlugins = getLoadedPluginsByPath();
+
+        debug("Plugin count: " + std::to_string(loadedPlugins.size()));
+
+        for (auto& plugin : m_vPlugins) {
+            info("Unloading plugin: " + plugin);
+
+            auto loadedPlugin = loadedPlugins.find(m_mPluginPaths[plugin]);
+
+            if (loadedPlugin == loadedPlugins.end()) {
+                debug("Plugin not found in plugin system, likely already unloaded, skipping "
+                      "unload...");
+                continue;
+            }
+
+            auto result = unloadPlugin(loadedPlugin->second);
+
+            if (result.isErr()) {
+                error("Failed to unload " + plugin + ": " + result.unwrapErr());
+            }
+        }
+
+        endSession();
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    Hyprload::reloadPlugin(const std::string& name) {
+        if (!m_sSessionGuid.has_value()) {
+            loadPlugins();
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        std::string plugin = getBinaryName(name);
+
+        std::filesystem::path binaryPath = getPluginBinariesPath() / plugin;
+
+        // The staged binary is stale now, so the preloader must not load it afterwards
+        m_mPreloading.erase(plugin);
+
+        // The new binary is picked up once the plugin may be loaded, instead of the stale copy
+        if (!shouldLoad(plugin)) {
+            std::error_code ec;
+            std::filesystem::remove(getSessionBinariesPath().value() / plugin, ec);
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        std::optional<std::filesystem::path> installedPath = plugin::findInstalledBinary(binaryPath);
+
+        if (!installedPath.has_value()) {
+            return hyprload::Result<std::monostate, std::string>::err("No binary installed for " +
+                                                                      name);
+        }
+
+        // The dynamic linker caches objects by path, so a compressed binary gets a fresh memory
+        // file. Decompressing it is left to the executor, loadPreloadedPlugins() swaps it in
+        if (compression::isCompressed(installedPath.value())) {
+            auto lazyPlugin = m_mLazyPlugins.find(plugin);
+            bool stubbed = lazyPlugin != m_mLazyPlugins.end() && lazyPlugin->second.m_bStubbed;
+
+            m_mPreloading[plugin] = installedPath.value();
+            queuePreload(preload::SPreloadRequest{plugin, installedPath.value(), !stubbed, true});
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        // And an uncompressed one a fresh directory
+        std::filesystem::path swapPath =
+            getSessionBinariesPath().value() / ("swap." + std::to_string(++m_iSwapGeneration));
+        std::filesystem::path pluginPath = swapPath / plugin;
+
+        std::error_code ec;
+        std::filesystem::create_directories(swapPath, ec);
+
+        if (!ec) {
+            std::filesystem::copy(installedPath.value(), pluginPath, ec);
+        }
+
+        if (ec) {
+            std::filesystem::remove_all(swapPath, ec);
+
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to stage new binary: " + ec.message());
+        }
+
+        auto preflight = preflightCheck(pluginPath);
+
+        if (preflight.isErr()) {
+            discardStagedBinary(pluginPath);
+
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Refusing to load new binary: " + preflight.unwrapErr());
+        }
+
+        return swapPlugin(plugin, pluginPath);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    Hyprload::swapPlugin(const std::string& plugin, const std::filesystem::path& pluginPath) {
+        auto lazyPlugin = m_mLazyPlugins.find(plugin);
+
+        // Until its first use, a lazy plugin only needs its stubs pointed at the new binary
+        if (lazyPlugin != m_mLazyPlugins.end() && lazyPlugin->second.m_bStubbed) {
+            std::filesystem::path stalePath = lazyPlugin->second.m_pPath;
+
+            if (stubLazyPlugin(plugin, pluginPath)) {
+                discardStagedBinary(stalePath);
+
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            }
+        }
+
+        // Kept until the new binary is loaded, to fall back to if it is not
+        std::optional<std::filesystem::path> previousPath = std::nullopt;
+        auto loadedPath = m_mPluginPaths.find(plugin);
+
+        if (loadedPath != m_mPluginPaths.end()) {
+            std::unordered_map<std::string, CPlugin*> loadedPlugins = getLoadedPluginsByPath();
+            auto loadedPlugin = loadedPlugins.find(loadedPath->second);
+
+            if (loadedPlugin != loadedPlugins.end()) {
+                auto result = unloadPlugin(loadedPlugin->second);
+
+                if (result.isErr()) {
+                    discardStagedBinary(pluginPath);
+
+                    return result;
+                }
+            }
+
+            previousPath = loadedPath->second;
+
+            m_mPluginPaths.erase(loadedPath);
+            m_vPlugins.erase(std::remove(m_vPlugins.begin(), m_vPlugins.end(), plugin),
+                             m_vPlugins.end());
+        }
+
+        auto result = loadPlugin(pluginPath);
+
+        if (result.isErr()) {
+            discardStagedBinary(pluginPath);
+
+            if (!previousPath.has_value()) {
+                return hyprload::Result<std::monostate, std::string>::err(result.unwrapErr());
+            }
+
+            auto previous = loadPlugin(previousPath.value());
+
+            if (previous.isErr()) {
+                discardStagedBinary(previousPath.value());
+
+                return hyprload::Result<std::monostate, std::string>::err(
+                    result.unwrapErr() + ", and the previous binary failed to load again: " +
+                    previous.unwrapErr());
+            }
+
+            m_vPlugins.push_back(plugin);
+            m_mPluginPaths[plugin] = previousPath.value();
+
+            if (m_mLazyPlugins.contains(plugin)) {
+                trackLazyDispatchers(plugin);
+            }
+
+            return hyprload::Result<std::monostate, std::string>::err(
+                result.unwrapErr() + ", kept the previous binary");
+        }
+
+        if (previousPath.has_value()) {
+            discardStagedBinary(previousPath.value());
+        }
+
+        m_vPlugins.push_back(plugin);
+        m_mPluginPaths[plugin] = pluginPath;
+
+        if (m_mLazyPlugins.contains(plugin)) {
+            m_mLazyPlugins[plugin].m_pPath = pluginPath;
+            trackLazyDispatchers(plugin);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    void Hyprload::switchProfile(const std::optional<std::string>& name) {
+        auto start = std::chrono::steady_clock::now();
+        std::optional<std::unordered_set<std::string>> profilePlugins = std::nullopt;
+
+        if (name.has_value()) {
+            config::g_pHyprloadConfig->reloadConfig();
+
+            auto profile = config::g_pHyprloadConfig->getProfile(name.value());
+
+            if (!profile.has_value()) {
+                error("No profile " + name.value() + " in " + config::getConfigPath().string());
+                return;
+            }
+
+            profilePlugins = std::unordered_set<std::string>();
+
+            for (const std::string& plugin : profile.value()) {
+                std::string binary = getBinaryName(plugin);
+
+                profilePlugins->insert(binary);
+
+                if (!plugin::findInstalledBinary(getPluginBinariesPath() / binary)) {
+                    error(plugin + " from profile " + name.value() + " is not installed");
+                }
+            }
+        }
+
+        m_sActiveProfile = name;
+        m_sProfilePlugins = std::move(profilePlugins);
+
+        std::string profileName = name.has_value() ? "profile " + name.value() : "all plugins";
+
+        if (!m_sSessionGuid.has_value()) {
+            info("Switched to " + profileName + ", it applies once plugins are loaded");
+            return;
+        }
+
+        auto [unloaded, loaded] = syncLoadedPlugins();
+
+        auto elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                  start);
+
+        success("Switched to " + profileName + ", unloaded " + std::to_string(unloaded) +
+                " and loaded " + std::to_string(loaded) + " plugins in " +
+                std::to_string(elapsed.count()) + "ms");
+    }
+
+    std::pair<usize, usize> Hyprload::syncLoadedPlugins() {
+        std::unordered_map<std::string, CPlugin*> loadedPlugins = getLoadedPluginsByPath();
+        usize unloaded = 0;
+        usize loaded = 0;
+
+        for (const std::string& plugin : std::vector<std::string>(m_vPlugins)) {
+            if (shouldLoad(plugin)) {
+                continue;
+            }
+
+            auto loadedPlugin = loadedPlugins.find(m_mPluginPaths[plugin]);
+
+            if (loadedPlugin != loadedPlugins.end()) {
+                auto result = unloadPlugin(loadedPlugin->second);
+
+                if (result.isErr()) {
+                    error("Failed to unload " + plugin + ": " + result.unwrapErr());
+                    continue;
+                }
+            }
+
+            releaseMemoryFile(m_mPluginPaths[plugin]);
+
+            m_mPluginPaths.erase(plugin);
+            m_mLazyPlugins.erase(plugin);
+            m_vPlugins.erase(std::remove(m_vPlugins.begin(), m_vPlugins.end(), plugin),
+                             m_vPlugins.end());
+
+            unloaded++;
+        }
+
+        for (auto lazyPlugin = m_mLazyPlugins.begin(); lazyPlugin != m_mLazyPlugins.end();) {
+            if (!lazyPlugin->second.m_bStubbed || shouldLoad(lazyPlugin->first)) {
+                ++lazyPlugin;
+                continue;
+            }
+
+            removeLazyStubs(lazyPlugin->first);
+            releaseMemoryFile(lazyPlugin->second.m_pPath);
+            lazyPlugin = m_mLazyPlugins.erase(lazyPlugin);
+        }
+
+        std::filesystem::path sessionPluginPath = getSessionBinariesPath().value();
+
+        for (const auto& entry : std::filesystem::directory_iterator(getPluginBinariesPath())) {
+            bool compressed = compression::isCompressed(entry.path());
+            std::filesystem::path binary = entry.path();
+
+            if (compressed) {
+                binary.replace_extension();
+            }
+
+            std::string plugin = binary.filename();
+
+            if (binary.extension() != ".so" || !shouldLoad(plugin) ||
+                m_mPluginPaths.contains(plugin) || m_mLazyPlugins.contains(plugin) ||
+                m_mPreloading.contains(plugin)) {
+                continue;
+            }
+
+            // Decompressed on the executor and loaded over the next ticks, like in loadPlugins()
+            if (compressed) {
+                const plugin::PluginRequirement* requirement = findRequirement(plugin);
+
+                m_mPreloading[plugin] = entry.path();
+                queuePreload(preload::SPreloadRequest{plugin, entry.path(),
+                                                      !requirement || !requirement->isLazy()});
+
+                loaded++;
+                continue;
+            }
+
+            // The session copy from loadPlugins() is reused, so switching back never copies
+            std::filesystem::path pluginPath = sessionPluginPath / plugin;
+
+            if (!std::filesystem::exists(pluginPath)) {
+                std::error_code ec;
+                std::filesystem::copy(entry.path(), pluginPath, ec);
+
+                if (ec) {
+                    error("Failed to copy " + plugin + ": " + ec.message());
+                    continue;
+                }
+            }
+
+            auto preflight = preflightCheck(pluginPath);
+
+            if (preflight.isErr()) {
+                error("Refusing to load " + plugin + ": " + preflight.unwrapErr());
+                releaseMemoryFile(pluginPath);
+                continue;
+            }
+
+            if (stubLazyPlugin(plugin, pluginPath)) {
+                continue;
+            }
+
+            auto result = loadPlugin(pluginPath);
+
+            if (result.isErr()) {
+                error("Failed to load " + plugin + ": " + result.unwrapErr());
+                releaseMemoryFile(pluginPath);
+                continue;
+            }
+
+            m_vPlugins.push_back(plugin);
+            m_mPluginPaths[plugin] = pluginPath;
+
+            loaded++;
+        }
+
+        return {unloaded, loaded};
+    }
+
+    bool Hyprload::isInActiveProfile(const std::string& plugin) const {
+        return !m_sProfilePlugins.has_value() || m_sProfilePlugins->contains(plugin);
+    }
+
+    bool Hyprload::shouldLoad(const std::string& plugin) const {
+        if (!isInActiveProfile(plugin)) {
+            return false;
+        }
+
+        if (!power::g_pPowerPolicy->shouldUnloadPowerHungry()) {
+            return true;
+        }
+
+        const plugin::PluginRequirement* requirement = findRequirement(plugin);
+
+        return !requirement || !requirement->isPowerHungry();
+    }
+
+    void Hyprload::applyPowerPolicy() {
+        bool deferBuilds = power::g_pPowerPolicy->shouldDeferBuilds();
+
+        pipeline::g_pExecutor->setResourcePaused(pipeline::eResource::CPU, deferBuilds);
+        pipeline::g_pExecutor->setResourceLimit(pipeline::eResource::CPU, getBuildSlots());
+
+        if (m_bIsBuilding && deferBuilds != m_bBuildsDeferred) {
+            info(deferBuilds ? "Deferring builds while on battery or hot" : "Resuming builds");
+        }
+
+        m_bBuildsDeferred = deferBuilds;
+
+        bool unloadPowerHungry = power::g_pPowerPolicy->shouldUnloadPowerHungry();
+
+        if (unloadPowerHungry == m_bPowerHungryUnloaded) {
+            return;
+        }
+
+        m_bPowerHungryUnloaded = unloadPowerHungry;
+
+        if (!m_sSessionGuid.has_value()) {
+            return;
+        }
+
+        // Only the power hungry plugins change, everything else stays loaded
+        auto [unloaded, loaded] = syncLoadedPlugins();
+
+        if (unloadPowerHungry && unloaded > 0) {
+            info("Unloaded " + std::to_string(unloaded) + " power hungry plugins until AC returns");
+        } else if (!unloadPowerHungry && loaded > 0) {
+            info("Reloaded " + std::to_string(loaded) + " power hungry plugins");
+        }
+    }
+
+    usize Hyprload::getBuildSlots() const {
+        return power::g_pPowerPolicy->shouldLimitBuilds() ? 1 : getBuildJobs();
+    }
+
+    std::string Hyprload::getBinaryName(const std::string& name) const {
+        // deploy() names the binary after the manifest's output
+        for (const plugin::PluginRequirement& requirement :
+             config::g_pHyprloadConfig->getPlugins()) {
+            if (requirement.getName() == name) {
+                return requirement.getSource()->getBinaryName(name);
+            }
+        }
+
+        return name + ".so";
+    }
+
+    const plugin::PluginRequirement* Hyprload::findRequirement(const std::string& plugin) const {
+        for (const plugin::PluginRequirement& requirement :
+             config::g_pHyprloadConfig->getPlugins()) {
+            // deploy() names the binary after the manifest's output
+            if (requirement.getSource()->getBinaryName(requirement.getName()) == plugin) {
+                return &requirement;
+            }
+        }
+
+        return nullptr;
+    }
+
+    std::optional<build::SToolchain>
+    Hyprload::resolveToolchain(const plugin::PluginRequirement& requirement, bool report) const {
+        std::optional<std::string> name = requirement.getToolchain().has_value() ?
+            requirement.getToolchain() :
+            getDefaultToolchain();
+
+        if (!name.has_value()) {
+            return std::nullopt;
+        }
+
+        std::optional<build::SToolchain> toolchain =
+            config::g_pHyprloadConfig->getToolchain(name.value());
+
+        if (!toolchain.has_value()) {
+            if (report) {
+                error("Toolchain " + name.value() + " of " + requirement.getName() + " is not in " +
+                      config::getConfigPath().string());
+            }
+
+            return std::nullopt;
+        }
+
+        return toolchain;
+    }
+
+    bool Hyprload::stubLazyPlugin(const std::string& plugin, const std::filesystem::path& path) {
+        removeLazyStubs(plugin);
+
+        const plugin::PluginRequirement* requirement = findRequirement(plugin);
+
+        if (!requirement || !requirement->isLazy()) {
+            m_mLazyPlugins.erase(plugin);
+            return false;
+        }
+
+        std::vector<std::string> dispatchers =
+            plugin::getInstalledDispatchers(getPluginBinariesPath() / plugin);
+
+        if (dispatchers.empty()) {
+            debug(plugin + " is lazy but declares no dispatchers, loading it right away");
+
+            m_mLazyPlugins.erase(plugin);
+            return false;
+        }
+
+        // A stub would replace the dispatcher another plugin registered under the same name
+        for (const std::string& dispatcher : dispatchers) {
+            if (g_pKeybindManager->m_mDispatchers.contains(dispatcher)) {
+                debug("Dispatcher " + dispatcher + " of " + plugin +
+                      " already exists, loading it right away");
+
+                m_mLazyPlugins.erase(plugin);
+                return false;
+            }
+        }
+
+        SLazyPlugin& lazyPlugin = m_mLazyPlugins[plugin];
+        lazyPlugin.m_vDispatchers = std::move(dispatchers);
+        lazyPlugin.m_iIdleUnload = requirement->getIdleUnload();
+        lazyPlugin.m_pPath = path;
+
+        addLazyStubs(plugin);
+
+        return true;
+    }
+
+    void Hyprload::addLazyStubs(const std::string& plugin) {
+        SLazyPlugin& lazyPlugin = m_mLazyPlugins[plugin];
+
+        // Loading from inside the call would remove the stub while it runs, so the call is
+        // queued for the next tick instead
+        for (const std::string& dispatcher : lazyPlugin.m_vDispatchers) {
+            HyprlandAPI::addDispatcher(PHANDLE, dispatcher,
+                                       [this, plugin, dispatcher](std::string args) {
+                                           m_vLazyDispatches.push_back(
+                                               SLazyDispatch{plugin, dispatcher, std::move(args)});
+                                       });
+        }
+
+        lazyPlugin.m_bStubbed = true;
+    }
+
+    void Hyprload::removeLazyStubs(const std::string& plugin) {
+        auto lazyPlugin = m_mLazyPlugins.find(plugin);
+
+        if (lazyPlugin == m_mLazyPlugins.end() || !lazyPlugin->second.m_bStubbed) {
+            return;
+        }
+
+        for (const std::string& dispatcher : lazyPlugin->second.m_vDispatchers) {
+            HyprlandAPI::removeDispatcher(PHANDLE, dispatcher);
+        }
+
+        lazyPlugin->second.m_bStubbed = false;
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    Hyprload::loadLazyPlugin(const std::string& plugin) {
+        auto start = std::chrono::steady_clock::now();
+        std::filesystem::path pluginPath = m_mLazyPlugins[plugin].m_pPath;
+
+        // The plugin registers the real dispatchers under the same names
+        removeLazyStubs(plugin);
+
+        auto result = loadPlugin(pluginPath);
+
+        if (result.isErr()) {
+            addLazyStubs(plugin);
+
+            return hyprload::Result<std::monostate, std::string>::err(result.unwrapErr());
+        }
+
+        m_vPlugins.push_back(plugin);
+        m_mPluginPaths[plugin] = pluginPath;
+        m_mLazyPlugins[plugin].m_tLastUse = std::chrono::steady_clock::now();
+
+        trackLazyDispatchers(plugin);
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        debug("Loaded " + plugin + " on first use in " + std::to_string(elapsed.count()) + "ms");
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    void Hyprload::trackLazyDispatchers(const std::string& plugin) {
+        SLazyPlugin& lazyPlugin = m_mLazyPlugins[plugin];
+        lazyPlugin.m_vHandlers.clear();
+
+        if (lazyPlugin.m_iIdleUnload == 0) {
+            return;
+        }
+
+        for (const std::string& dispatcher : lazyPlugin.m_vDispatchers) {
+            auto handler = g_pKeybindManager->m_mDispatchers.find(dispatcher);
+
+            if (handler == g_pKeybindManager->m_mDispatchers.end()) {
+                continue;
+            }
+
+            auto original =
+                std::make_shared<std::function<void(std::string)>>(std::move(handler->second));
+
+            handler->second = [this, plugin, original](std::string args) {
+                if (auto tracked = m_mLazyPlugins.find(plugin); tracked != m_mLazyPlugins.end()) {
+                    tracked->second.m_tLastUse = std::chrono::steady_clock::now();
+                }
+
+                (*original)(std::move(args));
+            };
+
+            lazyPlugin.m_vHandlers.emplace_back(dispatcher, original);
+        }
+    }
+
+    void Hyprload::runLazyDispatches() {
+        if (m_vLazyDispatches.empty()) {
+            return;
+        }
+
+        std::vector<SLazyDispatch> dispatches = std::move(m_vLazyDispatches);
+        m_vLazyDispatches = std::vector<SLazyDispatch>();
+
+        for (SLazyDispatch& dispatch : dispatches) {
+            auto lazyPlugin = m_mLazyPlugins.find(dispatch.m_sPlugin);
+
+            // Unloaded by a profile switch or a clear since the call was queued
+            if (lazyPlugin == m_mLazyPlugins.end()) {
+                continue;
+            }
+
+            if (lazyPlugin->second.m_bStubbed) {
+                info("Loading plugin on first use: " + dispatch.m_sPlugin);
+
+                auto result = loadLazyPlugin(dispatch.m_sPlugin);
+
+                if (result.isErr()) {
+                    error("Failed to load " + dispatch.m_sPlugin + ": " + result.unwrapErr());
+                    continue;
+                }
+            }
+
+            auto handler = g_pKeybindManager->m_mDispatchers.find(dispatch.m_sDispatcher);
+
+            if (handler == g_pKeybindManager->m_mDispatchers.end()) {
+                error(dispatch.m_sPlugin + " did not register its dispatcher " +
+                      dispatch.m_sDispatcher);
+                continue;
+            }
+
+            handler->second(std::move(dispatch.m_sArgs));
+        }
+    }
+
+    void Hyprload::loadPreloadedPlugins() {
+        if (!m_pPreloader || !m_pPreloader->m_mMutex.try_lock()) {
+            return;
+        }
+
+        std::vector<preload::SPreloaded> ready = std::move(m_pPreloader->m_vReady);
+        m_pPreloader->m_vReady = std::vector<preload::SPreloaded>();
+        bool done = m_pPreloader->m_bDone;
+        m_pPreloader->m_mMutex.unlock();
+
+        for (preload::SPreloaded& preloaded : ready) {
+            auto pending = m_mPreloading.find(preloaded.m_sPlugin);
+
+            // Reloaded, or left the profile, since it was staged
+            if (pending == m_mPreloading.end() || pending->second != preloaded.m_pStagedPath ||
+                !shouldLoad(preloaded.m_sPlugin)) {
+                if (pending != m_mPreloading.end()) {
+                    m_mPreloading.erase(pending);
+                }
+
+                preload::release(preloaded);
+                releaseMemoryFile(preloaded.m_pPath);
+                continue;
+            }
+
+            m_mPreloading.erase(pending);
+
+            if (preloaded.m_bRefused) {
+                error("Refusing to load " + preloaded.m_sPlugin + ": " +
+                      preloaded.m_sError.value());
+                preload::release(preloaded);
+
+                // A refused reload keeps the binary loaded now, rebuilding is up to its own run
+                if (!preloaded.m_bReload) {
+                    m_vRefusedPlugins.push_back(preloaded.m_sPlugin);
+                }
+
+                continue;
+            }
+
+            if (preloaded.m_sError.has_value()) {
+                error("Failed to decompress " + preloaded.m_sPlugin + ": " +
+                      preloaded.m_sError.value());
+                continue;
+            }
+
+            bool decompressed =
+                preloaded.m_iMemoryFile.has_value() || preloaded.m_bDecompressedFile;
+
+            // Taken over, so release() below only drops the handle
+            if (preloaded.m_iMemoryFile.has_value()) {
+                trackMemoryFile(preloaded.m_iMemoryFile.value());
+                preloaded.m_iMemoryFile = std::nullopt;
+            }
+
+            preloaded.m_bDecompressedFile = false;
+
+            if (preloaded.m_bReload) {
+                auto result = swapPlugin(preloaded.m_sPlugin, preloaded.m_pPath);
+
+                preload::release(preloaded);
+
+                if (result.isErr()) {
+                    error("Failed to reload " + preloaded.m_sPlugin + ": " + result.unwrapErr());
+                }
+
+                continue;
+            }
+
+            // Staged binaries were stubbed by loadPlugins() already
+            if (decompressed && stubLazyPlugin(preloaded.m_sPlugin, preloaded.m_pPath)) {
+                info("Deferring plugin until first use: " + preloaded.m_sPlugin);
+                preload::release(preloaded);
+                continue;
+            }
+
+            info("Loading plugin: " + preloaded.m_sPlugin);
+
+            auto result = loadPlugin(preloaded.m_pPath);
+
+            // The compositor holds its own reference now, or dropped it on failure
+            preload::release(preloaded);
+
+            if (result.isErr()) {
+                error("Failed to load " + preloaded.m_sPlugin + ": " + result.unwrapErr());
+
+                if (decompressed) {
+                    discardStagedBinary(preloaded.m_pPath);
+                }
+
+                continue;
+            }
+
+            m_vPlugins.push_back(preloaded.m_sPlugin);
+            m_mPluginPaths[preloaded.m_sPlugin] = preloaded.m_pPath;
+        }
+
+        if (done) {
+            m_pPreloader = nullptr;
+            m_mPreloading.clear();
+
+            // Not for reloads and profile switches queued on their own
+            if (m_bLoadingPlugins) {
+                m_bLoadingPlugins = false;
+                success("Plugins loaded!");
+            }
+
+            rebuildRefusedPlugins();
+        }
+    }
+
+    void Hyprload::queuePreload(preload::SPreloadRequest&& request) {
+        if (!m_pPreloader) {
+            m_pPreloader = std::make_shared<preload::Preloader>(
+                std::vector<preload::SPreloadRequest>(), getPreflightCheck(),
+                getSessionBinariesPath().value());
+            m_pPreloader->start();
+        }
+
+        m_pPreloader->add(std::move(request));
+    }
+
+    std::filesystem::path Hyprload::trackMemoryFile(fd_t fd) {
+        std::filesystem::path path = compression::getMemoryFilePath(fd);
+
+        m_mMemoryFiles[path.string()] = fd;
+
+        return path;
+    }
+
+    bool Hyprload::releaseMemoryFile(const std::filesystem::path& path) {
+        auto memoryFile = m_mMemoryFiles.find(path.string());
+
+        if (memoryFile == m_mMemoryFiles.end()) {
+            return false;
+        }
+
+        close(memoryFile->second);
+        m_mMemoryFiles.erase(memoryFile);
+
+        return true;
+    }
+
+    void Hyprload::discardStagedBinary(const std::filesystem::path& path) {
+        if (releaseMemoryFile(path)) {
+            return;
+        }
+
+        std::error_code ec;
+
+        if (path.parent_path() != getSessionBinariesPath().value()) {
+            std::filesystem::remove_all(path.parent_path(), ec);
+        } else {
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    void Hyprload::unloadIdlePlugins() {
+        auto now = std::chrono::steady_clock::now();
+        std::unordered_map<std::string, CPlugin*> loadedPlugins;
+
+        for (auto& [plugin, lazyPlugin] : m_mLazyPlugins) {
+            if (lazyPlugin.m_bStubbed || lazyPlugin.m_iIdleUnload == 0 ||
+                now - lazyPlugin.m_tLastUse < std::chrono::seconds(lazyPlugin.m_iIdleUnload) ||
+                !m_mPluginPaths.contains(plugin)) {
+                continue;
+            }
+
+            if (loadedPlugins.empty()) {
+                loadedPlugins = getLoadedPluginsByPath();
+            }
+
+            auto loadedPlugin = loadedPlugins.find(m_mPluginPaths[plugin]);
+
+            if (loadedPlugin != loadedPlugins.end()) {
+                auto result = unloadPlugin(loadedPlugin->second);
+
+                if (result.isErr()) {
+                    error("Failed to unload " + plugin + ": " + result.unwrapErr());
+
+                    lazyPlugin.m_tLastUse = now;
+                    continue;
+                }
+            }
+
+            m_mPluginPaths.erase(plugin);
+            m_vPlugins.erase(std::remove(m_vPlugins.begin(), m_vPlugins.end(), plugin),
+                             m_vPlugins.end());
+
+            lazyPlugin.m_vHandlers.clear();
+            addLazyStubs(plugin);
+
+            debug("Unloaded " + plugin + " after " + std::to_string(lazyPlugin.m_iIdleUnload) +
+                  "s without use");
+        }
+    }
+
+    void Hyprload::collectProfiles() {
+        // Collection starts over after every run, which may have swapped binaries underneath.
+        // While builds are deferred, the plugin would stay unloaded until they resume
+        if (m_bIsBuilding || m_bBuildsDeferred) {
+            m_mProfileCollections.clear();
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (now < m_tNextProfileCheck) {
+            return;
+        }
+
+        m_tNextProfileCheck = now + std::chrono::seconds(10);
 
-                if (std::none_of(requirements.begin(), requirements.end(),
-                                 [&pluginName](const plugin::PluginRequirement& requirement) {
-                                     return requirement.getName() == pluginName;
-                                 })) {
-                    debug("Plugin " + pluginName + " not in requirements, removing...");
+        std::unordered_map<std::string, CPlugin*> loadedPlugins;
 
-                    std::filesystem::remove(entry.path());
+        for (const std::string& plugin : std::vector<std::string>(m_vPlugins)) {
+            const plugin::PluginRequirement* requirement = findRequirement(plugin);
+
+            if (!requirement || m_sFailedCollections.contains(plugin)) {
+                continue;
+            }
+
+            std::optional<build::SToolchain> toolchain = resolveToolchain(*requirement, false);
+
+            if (!toolchain.has_value() || !toolchain->m_bPgo ||
+                !pgo::isCollecting(requirement->getName())) {
+                m_mProfileCollections.erase(plugin);
+                continue;
+            }
+
+            auto collection = m_mProfileCollections.try_emplace(plugin, now).first;
+
+            if (now - collection->second < std::chrono::seconds(getPgoCollectionTime())) {
+                continue;
+            }
+
+            m_mProfileCollections.erase(collection);
+
+            if (loadedPlugins.empty()) {
+                loadedPlugins = getLoadedPluginsByPath();
+            }
+
+            // Unloading runs the destructors that write out the counters
+            auto loadedPlugin = loadedPlugins.find(m_mPluginPaths[plugin]);
+
+            if (loadedPlugin != loadedPlugins.end()) {
+                auto result = unloadPlugin(loadedPlugin->second);
+
+                if (result.isErr()) {
+                    error("Failed to unload " + plugin + ": " + result.unwrapErr());
+                    continue;
+                }
+            }
+
+            releaseMemoryFile(m_mPluginPaths[plugin]);
+
+            m_mPluginPaths.erase(plugin);
+            m_mLazyPlugins.erase(plugin);
+            m_vPlugins.erase(std::remove(m_vPlugins.begin(), m_vPlugins.end(), plugin),
+                             m_vPlugins.end());
+
+            if (!pgo::hasProfileData(requirement->getName())) {
+                error("No profile was written for " + requirement->getName() +
+                      ", its build may not use CFLAGS and CXXFLAGS");
+
+                m_sFailedCollections.insert(plugin);
+
+                auto result = reloadPlugin(requirement->getName());
+
+                if (result.isErr()) {
+                    error("Failed to reload " + requirement->getName() + ": " + result.unwrapErr());
+                }
+
+                continue;
+            }
+
+            info("Collected the profile of " + requirement->getName() +
+                 ", rebuilding it optimized");
+
+            // Installing builds with the profile now, and reloading brings the plugin back
+            pgo::requestOptimizedBuild(requirement->getName());
+            m_sProfileRebuilds.insert(requirement->getName());
+            installPlugins(requirement->getName());
+        }
+    }
+
+    void Hyprload::releaseLazyPlugins() {
+        for (auto& [plugin, lazyPlugin] : m_mLazyPlugins) {
+            removeLazyStubs(plugin);
+
+            for (auto& [dispatcher, weakHandler] : lazyPlugin.m_vHandlers) {
+                std::shared_ptr<std::function<void(std::string)>> original = weakHandler.lock();
+                auto handler = g_pKeybindManager->m_mDispatchers.find(dispatcher);
+
+                if (original && handler != g_pKeybindManager->m_mDispatchers.end()) {
+                    handler->second = *original;
                 }
             }
         }
 
+        m_mLazyPlugins.clear();
+        m_vLazyDispatches.clear();
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    Hyprload::preflightCheck(const std::filesystem::path& path) {
+        return getPreflightCheck()(path);
+    }
+
+    preload::PreflightCheck Hyprload::getPreflightCheck() {
+        // The config and the running commit are read here, so workers only scan the binary
+        if (!isPreflightCheck()) {
+            return [](const std::filesystem::path&) {
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            };
+        }
+
+        return [runningCommit = getHyprlandCommit()](const std::filesystem::path& path) {
+            auto scanResult = elf::scanElf(path);
+
+            if (scanResult.isErr()) {
+                debug("Skipping preflight check: " + scanResult.unwrapErr());
+
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            }
+
+            return elf::checkCompatibility(scanResult.unwrap(), runningCommit);
+        };
+    }
+
+    hyprload::Result<CPlugin*, std::string>
+    Hyprload::loadPlugin(const std::filesystem::path& path) {
+        CPlugin* plugin = nullptr;
+
+        try {
+            plugin = g_pPluginSystem->loadPlugin(path.string());
+        } catch (const std::exception& e) {
+            return hyprload::Result<CPlugin*, std::string>::err(std::string(e.what()));
+        }
+
+        if (!plugin) {
+            return hyprload::Result<CPlugin*, std::string>::err(
+                "Hyprland rejected the plugin, check the Hyprland log");
+        }
+
+        return hyprload::Result<CPlugin*, std::string>::ok(std::move(plugin));
+    }
+
+    hyprload::Result<std::monostate, std::string> Hyprload::unloadPlugin(CPlugin* plugin) {
+        try {
+            g_pPluginSystem->unloadPlugin(plugin);
+        } catch (const std::exception& e) {
+            return hyprload::Result<std::monostate, std::string>::err(std::string(e.what()));
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    std::unordered_map<std::string, CPlugin*> Hyprload::getLoadedPluginsByPath() const {
+        std::unordered_map<std::string, CPlugin*> loadedPlugins =
+            std::unordered_map<std::string, CPlugin*>();
+
+        for (CPlugin* plugin : g_pPluginSystem->getAllPlugins()) {
+            loadedPlugins.emplace(plugin->path, plugin);
+        }
+
+        return loadedPlugins;
+    }
+
+    void Hyprload::cleanupPlugin() {
+        endSession();
+
+        for (std::thread* thread : {&m_tHeadersThread, &m_tGarbageCollectorThread,
+                                    &m_tUpdateCheckThread, &m_tMaintenanceThread}) {
+            if (thread->joinable()) {
+                debug("Waiting for a background job to finish...");
+                thread->join();
+            }
+        }
+    }
+
+    void Hyprload::startThread(std::thread& thread, std::function<void()>&& job) {
+        // Its result was already picked up, so at most the return is left
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        thread = std::thread(std::move(job));
+    }
+
+    void Hyprload::endSession() {
+        std::filesystem::path sessionPluginPath = getSessionBinariesPath().value();
+
+        releaseLazyPlugins();
+
+        if (m_pPreloader) {
+            m_pPreloader->cancel();
+            m_pPreloader = nullptr;
+        }
+
+        m_bLoadingPlugins = false;
+
+        // Loaded objects keep their mappings, the descriptors are only needed to load them
+        for (auto& [path, fd] : m_mMemoryFiles) {
+            close(fd);
+        }
+
+        m_mPreloading.clear();
+        m_mMemoryFiles.clear();
+        m_vPlugins.clear();
+        m_mPluginPaths.clear();
+        m_iSwapGeneration = 0;
+
+        debug("Removing lock file...");
+
+        unlockSession();
+
+        std::filesystem::remove_all(sessionPluginPath);
+
+        std::vector<std::string> requiredPlugins = std::vector<std::string>();
+
+        for (const plugin::PluginRequirement& requirement :
+             config::g_pHyprloadConfig->getPlugins()) {
+            requiredPlugins.push_back(requirement.getName());
+        }
+
+        plugin::removeUnrequiredBinaries(requiredPlugins);
+
         m_sSessionGuid = std::nullopt;
     }
 
     void Hyprload::reloadPlugins() {
+        if (m_bIsBuilding) {
+            m_bReloadQueued = true;
+
+            info("Reload queued until the current run finishes");
+            return;
+        }
+
         info("Reloading plugins...");
 
         clearPlugins();
         loadPlugins();
+    }
+
+    void Hyprload::collectGarbage(bool automatic) {
+        if (m_bIsBuilding) {
+            if (!automatic) {
+                error("Cannot collect garbage while updating plugins");
+            }
+            return;
+        }
+
+        if (m_pGarbageCollector) {
+            if (!automatic) {
+                error("Already collecting garbage");
+            }
+            return;
+        }
+
+        usize maxSize = getGcMaxSize();
+
+        if (automatic && maxSize == 0) {
+            return;
+        }
+
+        if (!automatic) {
+            info("Collecting garbage...");
+            maxSize = 0;
+        }
+
+        std::vector<std::filesystem::path> referencedSources = std::vector<std::filesystem::path>();
+        std::vector<std::string> requiredPlugins = std::vector<std::string>();
+
+        for (const plugin::PluginRequirement& requirement :
+             config::g_pHyprloadConfig->getPlugins()) {
+            requiredPlugins.push_back(requirement.getName());
+
+            auto gitSource =
+                std::dynamic_pointer_cast<plugin::GitPluginSource>(requirement.getSource());
+
+            if (gitSource) {
+                referencedSources.push_back(gitSource->getSourcePath());
+            }
+        }
+
+        m_pGarbageCollector = std::make_shared<gc::GarbageCollector>(
+            std::move(referencedSources), std::move(requiredPlugins), getHyprlandHeadersPath(),
+            maxSize);
+
+        startThread(m_tGarbageCollectorThread,
+                    [collector = m_pGarbageCollector]() { collector->collect(); });
+    }
+
+    void Hyprload::scheduleUpdateCheck() {
+        usize interval = getUpdateCheckInterval();
+
+        if (interval == 0 || isBusy()) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (now < m_tNextUpdateCheck) {
+            return;
+        }
+
+        // While a check is due but the machine is busy, look again a minute later
+        m_tNextUpdateCheck = now + std::chrono::minutes(1);
+
+        i64 lastCheck = updates::g_pUpdateCache->getLastCheckTime().value_or(0);
+
+        if (std::time(nullptr) - lastCheck < static_cast<i64>(interval)) {
+            return;
+        }
+
+        if (!system::isOnAcPower() || !system::isIdle()) {
+            return;
+        }
+
+        std::vector<std::pair<std::string, std::shared_ptr<plugin::PluginSource>>> sources =
+            std::vector<std::pair<std::string, std::shared_ptr<plugin::PluginSource>>>();
+
+        for (const plugin::PluginRequirement& requirement :
+             config::g_pHyprloadConfig->getPlugins()) {
+            sources.emplace_back(requirement.getName(), requirement.getSource());
+        }
+
+        sources.emplace_back("hyprload", std::make_shared<plugin::SelfSource>());
+
+        debug("Checking " + std::to_string(sources.size()) + " sources for updates");
+
+        m_pUpdateCheck = std::make_shared<updates::UpdateCheck>(std::move(sources));
+
+        startThread(m_tUpdateCheckThread, [check = m_pUpdateCheck]() { check->check(); });
+    }
+
+    void Hyprload::scheduleMaintenance() {
+        usize interval = getMaintenanceInterval();
+
+        if (interval == 0 || isBusy()) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (now < m_tNextMaintenance) {
+            return;
+        }
+
+        std::vector<maintenance::SRepository> repositories =
+            maintenance::findDueRepositories(interval);
+
+        if (repositories.empty()) {
+            m_tNextMaintenance = now + std::chrono::hours(1);
+            return;
+        }
+
+        m_tNextMaintenance = now + std::chrono::minutes(1);
+
+        if (!system::isOnAcPower() || !system::isIdle()) {
+            return;
+        }
+
+        debug("Maintaining " + std::to_string(repositories.size()) + " repositories");
+
+        m_pMaintenance = std::make_shared<maintenance::RepositoryMaintenance>(
+            std::move(repositories), getMaintenanceTimeLimit());
+
+        startThread(m_tMaintenanceThread,
+                    [maintenance = m_pMaintenance]() { maintenance->run(); });
+    }
+
+    bool Hyprload::isBusy() const {
+        return m_bIsBuilding || m_pGarbageCollector || m_pUpdateCheck || m_pMaintenance;
+    }
+
+    void Hyprload::showUpdateStatus() {
+        std::optional<i64> lastCheck = updates::g_pUpdateCache->getLastCheckTime();
+
+        if (m_pUpdateCheck) {
+            info("Checking for updates...");
+            return;
+        }
 
-        success("Reloaded plugins!");
+        if (!lastCheck.has_value()) {
+            info(getUpdateCheckInterval() == 0 ?
+                     "Update checks are disabled, set " + c_updateCheckInterval + " to enable them" :
+                     "No update check has run yet");
+            return;
+        }
+
+        std::vector<std::string> available = updates::g_pUpdateCache->getAvailableUpdates();
+        std::string checked = " (checked " +
+            std::to_string((std::time(nullptr) - lastCheck.value()) / 60) + " minutes ago)";
+
+        if (available.empty()) {
+            info("All plugins are up to date" + checked);
+            return;
+        }
+
+        std::string names = std::string();
+
+        for (const std::string& name : available) {
+            names += (names.empty() ? "" : ", ") + name;
+        }
+
+        info(std::to_string(available.size()) + " updates available: " + names + checked, 10000);
     }
 
     const std::vector<std::string>& Hyprload::getLoadedPlugins() const {
@@ -545,7 +2021,7 @@ namespace hyprload {
             return std::nullopt;
         }
 
-        return getPluginsPath() / ("session." + m_sSessionGuid.value());
+        return getSessionsPath() / ("session." + m_sSessionGuid.value());
     }
 
     bool Hyprload::lockSession() {
@@ -581,9 +2057,20 @@ namespace hyprload {
     }
 
     void tryCleanupPreviousSessions() {
-        std::filesystem::path pluginsPath = getPluginsPath();
+        tryCleanupPreviousSessions(getSessionsPath());
+
+        // Sessions left behind from before switching layouts
+        if (getSessionsPath() != getPluginsPath()) {
+            tryCleanupPreviousSessions(getPluginsPath());
+        }
+    }
+
+    void tryCleanupPreviousSessions(const std::filesystem::path& sessionsPath) {
+        if (!std::filesystem::exists(sessionsPath)) {
+            return;
+        }
 
-        for (const auto& entry : std::filesystem::directory_iterator(pluginsPath)) {
+        for (const auto& entry : std::filesystem::directory_iterator(sessionsPath)) {
             std::string sessionPath = entry.path().filename();
             if (sessionPath.find("session.") != std::string::npos) {
                 debug("Found previous session: " + sessionPath);
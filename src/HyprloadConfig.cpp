@@ -79,4 +79,56 @@ namespace hyprload::config {
     const std::vector<hyprload::plugin::PluginRequirement>& HyprloadConfig::getPlugins() const {
         return m_vPluginsWanted;
     }
+
+    std::optional<std::vector<std::string>>
+    HyprloadConfig::getProfile(const std::string& name) const {
+        if (!m_pConfig) {
+            return std::nullopt;
+        }
+
+        const toml::array* plugins = (*m_pConfig)["profiles"][name]["plugins"].as_array();
+
+        if (!plugins) {
+            return std::nullopt;
+        }
+
+        std::vector<std::string> profile = std::vector<std::string>();
+
+        plugins->for_each([&profile](const toml::node& value) {
+            if (value.is_string()) {
+                profile.push_back(value.as_string()->get());
+            } else {
+                hyprload::error("Profile plugins must be plugin names");
+            }
+        });
+
+        return profile;
+    }
+
+    std::optional<hyprload::build::SToolchain>
+    HyprloadConfig::getToolchain(const std::string& name) const {
+        if (!m_pConfig) {
+            return std::nullopt;
+        }
+
+        const toml::table* toolchain = (*m_pConfig)["toolchains"][name].as_table();
+
+        if (!toolchain) {
+            return std::nullopt;
+        }
+
+        auto getString = [toolchain](const std::string& key) {
+            if (toolchain->contains(key) && toolchain->get(key)->is_string()) {
+                return toolchain->get(key)->as_string()->get();
+            }
+
+            return std::string();
+        };
+
+        bool pgo = toolchain->contains("pgo") && toolchain->get("pgo")->is_boolean() &&
+            toolchain->get("pgo")->as_boolean()->get();
+
+        return hyprload::build::SToolchain{getString("cc"), getString("cxx"), getString("cflags"),
+                                           getString("cxxflags"), getString("ldflags"), pgo};
+    }
 }
@@ -4,6 +4,7 @@
 
 #include "HyprloadOverlay.hpp"
 #include "Hyprload.hpp"
+#include "UpdateChecker.hpp"
 
 #include <algorithm>
 
@@ -165,7 +166,13 @@ namespace hyprload::overlay {
                 1.0f :
                 1.0f - getAnimationCurve()->getYForPoint(1.0f - m_fProgress);
 
-        const std::vector<std::string>& plugins = g_pHyprload->getLoadedPlugins();
+        std::vector<std::string> plugins = g_pHyprload->getLoadedPlugins();
+
+        // Counted when the cache changes, the cache file is never read while rendering
+        if (usize updates = updates::g_pUpdateCache->getAvailableUpdateCount(); updates > 0) {
+            plugins.push_back(std::to_string(updates) + " updates available");
+        }
+
         const i32 pluginCount = plugins.size();
         i32 pluginIndex = 0;
 
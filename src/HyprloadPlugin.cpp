@@ -3,13 +3,24 @@
 
 #include "HyprloadPlugin.hpp"
 #include "Hyprload.hpp"
+#include "BuildEnvironment.hpp"
+#include "Compression.hpp"
+#include "ElfScanner.hpp"
+#include "GitBackend.hpp"
+#include "Pgo.hpp"
+#include "SharedCache.hpp"
+#include "SystemMonitor.hpp"
 
 #include <algorithm>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
@@ -66,9 +77,204 @@ namespace hyprload::plugin {
         return hyprload::Result<PluginManifest, std::string>::ok(std::move(pluginManifest.value()));
     }
 
+    std::mutex g_mPulledSourcesMutex;
+    std::unordered_set<std::string> g_sPulledSources;
+
+    void startRun() {
+        auto lock = std::scoped_lock<std::mutex>(g_mPulledSourcesMutex);
+
+        g_sPulledSources.clear();
+    }
+
+    bool wasPulledInRun(const std::filesystem::path& sourcePath) {
+        auto lock = std::scoped_lock<std::mutex>(g_mPulledSourcesMutex);
+
+        return g_sPulledSources.contains(sourcePath.string());
+    }
+
+    void markPulled(const std::filesystem::path& sourcePath) {
+        auto lock = std::scoped_lock<std::mutex>(g_mPulledSourcesMutex);
+
+        g_sPulledSources.insert(sourcePath.string());
+    }
+
+    const std::string c_selfUrl = "https://github.com/Duckonaut/hyprload.git";
+
+    hyprload::Result<std::monostate, std::string>
+    fetchAndFastForward(const std::filesystem::path& sourcePath) {
+        git::GitBackend& backend = git::getBackend();
+
+        // Sources are cloned shallow, and stay that way, see GitBackend::fetch()
+        auto result =
+            backend.fetch(sourcePath, git::makeProgressReporter("Fetching " + sourcePath.string()));
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        return backend.fastForward(sourcePath);
+    }
+
+    // The registered toolchain of name, with the flags of its PGO phase for the revision
+    // checked out at sourcePath
+    std::optional<build::SToolchain> getBuildToolchain(const std::string& name,
+                                                       const std::filesystem::path& sourcePath) {
+        std::optional<build::SToolchain> toolchain = build::getPluginToolchain(name);
+
+        if (toolchain.has_value() && toolchain->m_bPgo) {
+            return pgo::applyPhase(name, pgo::getPhase(name, sourcePath), toolchain.value());
+        }
+
+        return toolchain;
+    }
+
+    // The source revision and headers commit a binary was built from, its toolchain, and the
+    // environment of hermetic builds. Instances sharing a root compare it against the
+    // installed binary, so the same build never runs twice
+    std::optional<std::string> getBuildKey(const std::filesystem::path& sourcePath,
+                                           const std::string& name,
+                                           const std::filesystem::path& hyprlandHeadersPath) {
+        std::optional<std::string> revision = git::getBackend().getHead(sourcePath);
+        std::optional<std::string> headersCommit = getHeadersCommit(hyprlandHeadersPath);
+
+        if (!revision.has_value() || !headersCommit.has_value()) {
+            return std::nullopt;
+        }
+
+        std::string buildKey = revision.value() + "-" + headersCommit.value();
+        std::optional<build::SToolchain> toolchain = getBuildToolchain(name, sourcePath);
+
+        // The hermetic environment already covers the toolchain
+        if (isHermeticBuilds()) {
+            buildKey += "-" +
+                build::makeHermeticEnvironment(sourcePath, hyprlandHeadersPath, toolchain).m_sHash;
+        } else if (toolchain.has_value()) {
+            buildKey += "-" + build::getToolchainHash(toolchain.value());
+        }
+
+        return buildKey;
+    }
+
+    std::filesystem::path getBuildKeyPath(const std::filesystem::path& installedBinary) {
+        std::filesystem::path keyPath = installedBinary;
+        keyPath += ".key";
+
+        return keyPath;
+    }
+
+    void forgetInstalledBuild(const std::filesystem::path& installedBinary) {
+        std::error_code ec;
+
+        std::filesystem::remove(getBuildKeyPath(installedBinary), ec);
+    }
+
+    usize removeUnrequiredBinaries(const std::vector<std::string>& requiredPlugins) {
+        std::filesystem::path pluginBinariesPath = hyprload::getPluginBinariesPath();
+        usize freed = 0;
+
+        if (!std::filesystem::exists(pluginBinariesPath)) {
+            return 0;
+        }
+
+        FileLock binariesLock = FileLock(getLockFile("bin"));
+
+        for (auto& entry : std::filesystem::directory_iterator(pluginBinariesPath)) {
+            std::string filename = entry.path().filename();
+            if (filename.find(".so") == std::string::npos) {
+                continue;
+            }
+
+            std::string pluginName = filename.substr(0, filename.find(".so"));
+
+            if (std::find(requiredPlugins.begin(), requiredPlugins.end(), pluginName) !=
+                requiredPlugins.end()) {
+                continue;
+            }
+
+            debug("Plugin " + pluginName + " not in requirements, removing...");
+
+            std::filesystem::path debugFile =
+                hyprload::getPluginDebugInfoPath() / (pluginName + ".so.debug");
+            std::filesystem::path profilePath = pgo::getProfilePath(pluginName);
+            std::error_code ec;
+
+            freed += getDiskUsage(entry.path()) + getDiskUsage(debugFile) +
+                getDiskUsage(profilePath);
+            std::filesystem::remove(entry.path(), ec);
+            std::filesystem::remove(debugFile, ec);
+            std::filesystem::remove_all(profilePath, ec);
+        }
+
+        return freed;
+    }
+
+    bool isInstalledBuild(const std::filesystem::path& outputBinary, const std::string& buildKey) {
+        std::filesystem::path targetPath =
+            hyprload::getPluginBinariesPath() / outputBinary.filename();
+
+        if (!findInstalledBinary(targetPath).has_value()) {
+            return false;
+        }
+
+        std::ifstream keyFile = std::ifstream(getBuildKeyPath(targetPath));
+        std::string installedKey;
+
+        return std::getline(keyFile, installedKey) && installedKey == buildKey;
+    }
+
+    std::optional<std::filesystem::path> findInstalledBinary(const std::filesystem::path& binary) {
+        if (std::filesystem::exists(binary)) {
+            return binary;
+        }
+
+        std::filesystem::path compressedPath = compression::getCompressedPath(binary);
+
+        if (std::filesystem::exists(compressedPath)) {
+            return compressedPath;
+        }
+
+        return std::nullopt;
+    }
+
+    std::filesystem::path getDispatchersPath(const std::filesystem::path& installedBinary) {
+        std::filesystem::path dispatchersPath = installedBinary;
+        dispatchersPath += ".dispatchers";
+
+        return dispatchersPath;
+    }
+
+    std::vector<std::string> getInstalledDispatchers(const std::filesystem::path& installedBinary) {
+        std::vector<std::string> dispatchers = std::vector<std::string>();
+        std::ifstream dispatchersFile = std::ifstream(getDispatchersPath(installedBinary));
+        std::string dispatcher;
+
+        while (std::getline(dispatchersFile, dispatcher)) {
+            if (!dispatcher.empty()) {
+                dispatchers.push_back(dispatcher);
+            }
+        }
+
+        return dispatchers;
+    }
+
+    // Keeps builds off the performance cores the render thread needs, unless configured
+    // otherwise or the CPU is not hybrid
+    std::optional<std::vector<usize>> getBuildCpus() {
+        std::string affinity = getBuildAffinity();
+
+        if (affinity == "all" || (affinity == "all_when_idle" && system::isIdle())) {
+            return std::nullopt;
+        }
+
+        return system::getEfficiencyCpus();
+    }
+
     hyprload::Result<std::monostate, std::string>
     buildPlugin(const std::filesystem::path& sourcePath, const std::string& name,
                 const std::filesystem::path& hyprlandHeadersPath) {
+        // Keeps another instance from checking out different headers mid-build
+        FileLock headersLock = FileLock(getPathLockFile("headers", hyprlandHeadersPath), true);
+
         auto pluginManifestResult = getPluginManifest(sourcePath, name);
 
         if (pluginManifestResult.isErr()) {
@@ -78,17 +284,57 @@ namespace hyprload::plugin {
 
         const auto& pluginManifest = pluginManifestResult.unwrap();
 
+        std::optional<build::SToolchain> toolchain = build::getPluginToolchain(name);
+        std::optional<pgo::ePhase> pgoPhase = std::nullopt;
+
+        if (toolchain.has_value() && toolchain->m_bPgo) {
+            pgoPhase = pgo::getPhase(name, sourcePath);
+            toolchain = pgo::applyPhase(name, pgoPhase.value(), toolchain.value());
+
+            auto prepareResult = pgo::prepareBuild(name, pgoPhase.value());
+
+            if (prepareResult.isErr()) {
+                pgo::finishBuild(name, sourcePath, pgoPhase.value(), false);
+
+                return prepareResult;
+            }
+        }
+
         std::string buildSteps = "export HYPRLAND_HEADERS=" + hyprlandHeadersPath.string() +
             " && cd " + sourcePath.string() + " && ";
 
+        // Hermetic builds get the toolchain through their environment instead
+        if (toolchain.has_value() && !isHermeticBuilds()) {
+            for (const auto& [variable, value] : build::getToolchainVariables(toolchain.value())) {
+                buildSteps += "export " + variable + "=" + build::shellQuote(value) + " && ";
+            }
+        }
+
         for (const std::string& step : pluginManifest.getBuildSteps()) {
             buildSteps += step + " && ";
         }
 
         buildSteps += "cd -";
 
+        if (isHermeticBuilds()) {
+            buildSteps = build::wrapCommand(
+                build::makeHermeticEnvironment(sourcePath, hyprlandHeadersPath, toolchain),
+                buildSteps);
+        }
+
+        std::optional<std::vector<usize>> buildCpus = getBuildCpus();
+        std::optional<system::ScopedAffinity> affinity = std::nullopt;
+
+        if (buildCpus.has_value()) {
+            affinity.emplace(buildCpus.value());
+        }
+
         auto [exit, output] = executeCommand(buildSteps);
 
+        if (pgoPhase.has_value()) {
+            pgo::finishBuild(name, sourcePath, pgoPhase.value(), exit == 0);
+        }
+
         if (exit != 0) {
             return hyprload::Result<std::monostate, std::string>::err("Failed to build plugin: " +
                                                                       output);
@@ -97,6 +343,187 @@ namespace hyprload::plugin {
         return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
     }
 
+    hyprload::Result<std::monostate, std::string>
+    splitDebugInfo(const std::filesystem::path& binary, const std::filesystem::path& debugFile) {
+        std::string command = "objcopy --only-keep-debug " + binary.string() + " " +
+            debugFile.string() + " && objcopy --strip-debug --add-gnu-debuglink=" +
+            debugFile.string() + " " + binary.string();
+
+        auto [exit, output] = executeCommand(command);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to split debug info: " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    addHeadersNote(const std::filesystem::path& binary,
+                   const std::filesystem::path& hyprlandHeadersPath) {
+        std::optional<std::string> headersCommit = getHeadersCommit(hyprlandHeadersPath);
+
+        if (!headersCommit.has_value()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to determine the commit of " + hyprlandHeadersPath.string());
+        }
+
+        std::filesystem::path notePath = binary;
+        notePath += ".note";
+
+        auto result = elf::writeHeadersNote(notePath, headersCommit.value());
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        std::string command = "objcopy --remove-section " + elf::c_noteSection +
+            " --add-section " + elf::c_noteSection + "=" + notePath.string() +
+            " --set-section-flags " + elf::c_noteSection + "=noload,readonly " + binary.string();
+
+        auto [exit, output] = executeCommand(command);
+
+        std::filesystem::remove(notePath);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to add headers note: " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    installPluginBinary(const std::filesystem::path& outputBinary,
+                        const std::filesystem::path& hyprlandHeadersPath,
+                        const std::optional<std::string>& buildKey,
+                        const std::vector<std::string>& dispatchers) {
+        std::error_code ec;
+
+        if (!std::filesystem::exists(outputBinary, ec)) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Plugin binary does not exist");
+        }
+
+        FileLock binariesLock = FileLock(getLockFile("bin"));
+
+        std::filesystem::path targetPath =
+            hyprload::getPluginBinariesPath() / outputBinary.filename();
+
+        // Stage next to the target, so the final swap is a single rename
+        std::filesystem::path stagingPath = targetPath;
+        stagingPath += ".tmp";
+
+        std::filesystem::path compressedStagingPath = compression::getCompressedPath(stagingPath);
+
+        // Leave nothing staged behind, the next install would otherwise trip over it
+        auto fail = [&stagingPath, &compressedStagingPath](const std::string& message,
+                                                           const std::error_code& ec) {
+            std::error_code removeEc;
+            std::filesystem::remove(stagingPath, removeEc);
+            std::filesystem::remove(compressedStagingPath, removeEc);
+
+            return hyprload::Result<std::monostate, std::string>::err(message + ": " +
+                                                                      ec.message());
+        };
+
+        std::filesystem::copy_file(outputBinary, stagingPath,
+                                   std::filesystem::copy_options::overwrite_existing, ec);
+
+        if (ec) {
+            return fail("Failed to stage " + outputBinary.filename().string(), ec);
+        }
+
+        // Record the headers commit, so loadPlugins() can refuse binaries built for another
+        // compositor before they get a chance to crash it
+        auto noteResult = addHeadersNote(stagingPath, hyprlandHeadersPath);
+
+        if (noteResult.isErr()) {
+            debug(noteResult.unwrapErr());
+        }
+
+        if (isSplitDebugInfo()) {
+            std::filesystem::path debugInfoPath = hyprload::getPluginDebugInfoPath();
+
+            // Splitting fails below without it, which installs the unstripped binary
+            std::filesystem::create_directories(debugInfoPath, ec);
+
+            std::filesystem::path debugFile = debugInfoPath / outputBinary.filename();
+            debugFile += ".debug";
+
+            auto result = splitDebugInfo(stagingPath, debugFile);
+
+            if (result.isErr()) {
+                debug(result.unwrapErr() + ", installing unstripped binary");
+
+                std::filesystem::copy_file(outputBinary, stagingPath,
+                                           std::filesystem::copy_options::overwrite_existing, ec);
+
+                if (ec) {
+                    return fail("Failed to stage " + outputBinary.filename().string(), ec);
+                }
+
+                addHeadersNote(stagingPath, hyprlandHeadersPath);
+            }
+        }
+
+        std::filesystem::path compressedPath = compression::getCompressedPath(targetPath);
+        bool compressed = false;
+
+        if (isCompressBinaries()) {
+            auto result = compression::compressFile(stagingPath, compressedStagingPath);
+
+            if (result.isOk()) {
+                std::filesystem::rename(compressedStagingPath, compressedPath, ec);
+
+                if (ec) {
+                    return fail("Failed to install " + compressedPath.filename().string(), ec);
+                }
+
+                std::filesystem::remove(stagingPath, ec);
+                std::filesystem::remove(targetPath, ec);
+
+                compressed = true;
+            } else {
+                debug(result.unwrapErr() + ", installing uncompressed binary");
+
+                std::filesystem::remove(compressedStagingPath, ec);
+            }
+        }
+
+        // Only one of the two is kept, so loadPlugins() never finds both
+        if (!compressed) {
+            std::filesystem::rename(stagingPath, targetPath, ec);
+
+            if (ec) {
+                return fail("Failed to install " + targetPath.filename().string(), ec);
+            }
+
+            std::filesystem::remove(compressedPath, ec);
+        }
+
+        if (buildKey.has_value()) {
+            std::ofstream keyFile = std::ofstream(getBuildKeyPath(targetPath), std::ios::trunc);
+            keyFile << buildKey.value() << std::endl;
+        } else {
+            std::filesystem::remove(getBuildKeyPath(targetPath), ec);
+        }
+
+        if (!dispatchers.empty()) {
+            std::ofstream dispatchersFile =
+                std::ofstream(getDispatchersPath(targetPath), std::ios::trunc);
+
+            for (const std::string& dispatcher : dispatchers) {
+                dispatchersFile << dispatcher << std::endl;
+            }
+        } else {
+            std::filesystem::remove(getDispatchersPath(targetPath), ec);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
     PluginManifest::PluginManifest(std::string&& name, const toml::table& manifest) {
         m_sName = name;
 
@@ -150,6 +577,16 @@ namespace hyprload::plugin {
         } else {
             throw std::runtime_error("Plugin must have a build table");
         }
+
+        if (manifest.contains("dispatchers") && manifest["dispatchers"].is_array()) {
+            manifest["dispatchers"].as_array()->for_each(
+                [&dispatchers = m_sDispatchers](const toml::node& value) {
+                    if (!value.is_string()) {
+                        throw std::runtime_error("Dispatcher must be a string");
+                    }
+                    dispatchers.push_back(value.as_string()->get());
+                });
+        }
     }
 
     const std::string& PluginManifest::getName() const {
@@ -176,6 +613,10 @@ namespace hyprload::plugin {
         return m_sBuildSteps;
     }
 
+    const std::vector<std::string>& PluginManifest::getDispatchers() const {
+        return m_sDispatchers;
+    }
+
     HyprloadManifest::HyprloadManifest(const toml::table& manifest) {
         m_vPlugins = std::vector<PluginManifest>();
         manifest.for_each([&plugins = m_vPlugins](const toml::key& key, const toml::node& value) {
@@ -191,6 +632,18 @@ namespace hyprload::plugin {
         return m_vPlugins;
     }
 
+    std::optional<std::string> PluginSource::getRevision() {
+        return std::nullopt;
+    }
+
+    std::optional<std::string> PluginSource::getRemoteRevision() {
+        return std::nullopt;
+    }
+
+    std::string PluginSource::getBinaryName(const std::string& name) const {
+        return name + ".so";
+    }
+
     bool PluginSource::operator==(const PluginSource& other) const {
         if (typeid(*this) != typeid(other)) {
             return false;
@@ -213,19 +666,19 @@ namespace hyprload::plugin {
         std::string name = m_sUrl.substr(m_sUrl.find_last_of('/') + 1);
         name = name.substr(0, name.find_last_of('.'));
 
-        m_pSourcePath = hyprload::getPluginsPath() / "src" / name;
+        m_pSourcePath = hyprload::getPluginSourcesPath() / name;
     }
 
     hyprload::Result<std::monostate, std::string> GitPluginSource::installSource() {
-        std::string command = "git clone " + m_sUrl + " " + m_pSourcePath.string() + " --branch " +
-            m_sBranch + " --depth 1";
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
 
-        if (std::system(command.c_str()) != 0) {
-            return hyprload::Result<std::monostate, std::string>::err(
-                "Failed to clone plugin source");
+        // Another instance may have cloned it while we waited
+        if (isSourceAvailable()) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
         }
 
-        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        return git::getBackend().clone(m_sUrl, m_sBranch, m_pSourcePath, 1, false,
+                                       git::makeProgressReporter("Cloning " + m_sUrl));
     }
 
     bool GitPluginSource::isSourceAvailable() {
@@ -233,17 +686,18 @@ namespace hyprload::plugin {
     }
 
     bool GitPluginSource::isUpToDate() {
-        std::string command = "git -C " + m_pSourcePath.string() + " remote update";
-
-        if (std::system(command.c_str()) != 0) {
-            return false;
-        }
+        std::optional<std::string> revision = getRevision();
 
-        command = "git -C " + m_pSourcePath.string() + " status -uno";
+        return revision.has_value() && revision == getRemoteRevision();
+    }
 
-        auto [exit, output] = executeCommand(command);
+    std::optional<std::string> GitPluginSource::getRevision() {
+        return git::getBackend().getHead(m_pSourcePath);
+    }
 
-        return exit != 0 && output.find("behind") == std::string::npos;
+    std::optional<std::string> GitPluginSource::getRemoteRevision() {
+        return git::getBackend().lsRemote(m_sUrl,
+                                          m_sBranch.empty() ? "HEAD" : "refs/heads/" + m_sBranch);
     }
 
     bool GitPluginSource::providesPlugin(const std::string& name) const {
@@ -256,13 +710,41 @@ namespace hyprload::plugin {
         return true;
     }
 
+    std::string GitPluginSource::getBinaryName(const std::string& name) const {
+        auto pluginManifest = getPluginManifest(m_pSourcePath, name);
+
+        if (pluginManifest.isErr()) {
+            return PluginSource::getBinaryName(name);
+        }
+
+        return pluginManifest.unwrap().getBinaryOutputPath().filename();
+    }
+
+    hyprload::Result<std::monostate, std::string> GitPluginSource::pullSource() {
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
+
+        if (wasPulledInRun(m_pSourcePath)) {
+            debug("Reusing this run's pull of " + m_pSourcePath.string());
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        auto result = fetchAndFastForward(m_pSourcePath);
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        markPulled(m_pSourcePath);
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
     hyprload::Result<std::monostate, std::string>
     GitPluginSource::update(const std::string& name, const std::filesystem::path& hyprlandHeaders) {
-        std::string command = "git -C " + m_pSourcePath.string() + " pull";
+        auto result = pullSource();
 
-        if (std::system(command.c_str()) != 0) {
-            return hyprload::Result<std::monostate, std::string>::err(
-                "Failed to update plugin source");
+        if (result.isErr()) {
+            return result;
         }
 
         return this->install(name, hyprlandHeaders);
@@ -272,7 +754,11 @@ namespace hyprload::plugin {
     GitPluginSource::install(const std::string& name,
                              const std::filesystem::path& hyprlandHeaders) {
         if (!this->isSourceAvailable()) {
-            return this->installSource();
+            auto result = this->installSource();
+
+            if (result.isErr()) {
+                return result;
+            }
         }
 
         auto result = build(name, hyprlandHeaders);
@@ -281,6 +767,14 @@ namespace hyprload::plugin {
             return result;
         }
 
+        return deploy(name, hyprlandHeaders);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    GitPluginSource::deploy(const std::string& name,
+                            const std::filesystem::path& hyprlandHeaders) {
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
+
         auto pluginManifestResult = getPluginManifest(m_pSourcePath, name);
 
         if (pluginManifestResult.isErr()) {
@@ -289,29 +783,93 @@ namespace hyprload::plugin {
         }
 
         auto pluginManifest = pluginManifestResult.unwrap();
-
         std::filesystem::path outputBinary = m_pSourcePath / pluginManifest.getBinaryOutputPath();
+        std::optional<std::string> buildKey = getBuildKey(m_pSourcePath, name, hyprlandHeaders);
 
-        if (!std::filesystem::exists(outputBinary)) {
-            return hyprload::Result<std::monostate, std::string>::err(
-                "Plugin binary does not exist");
+        if (buildKey.has_value() && isInstalledBuild(outputBinary, buildKey.value())) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
         }
 
-        std::filesystem::path targetPath =
-            hyprload::getPluginBinariesPath() / outputBinary.filename();
+        std::optional<std::filesystem::path> sharedCache = getSharedCachePath();
 
-        if (std::filesystem::exists(targetPath)) {
-            std::filesystem::remove(targetPath);
-        }
+        // build() skips the build when another user already published it
+        if (sharedCache.has_value() && buildKey.has_value()) {
+            std::filesystem::path artifact =
+                cache::getArtifactPath(sharedCache.value(), getArtifactKey(name, buildKey.value()),
+                                       outputBinary.filename().string());
 
-        std::filesystem::copy(outputBinary, targetPath);
+            if (std::filesystem::exists(artifact)) {
+                outputBinary = artifact;
+            }
+        }
 
-        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        return installPluginBinary(outputBinary, hyprlandHeaders, buildKey,
+                                   pluginManifest.getDispatchers());
     }
 
     hyprload::Result<std::monostate, std::string>
     GitPluginSource::build(const std::string& name, const std::filesystem::path& hyprlandHeaders) {
-        return buildPlugin(m_pSourcePath, name, hyprlandHeaders);
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
+
+        auto pluginManifestResult = getPluginManifest(m_pSourcePath, name);
+
+        if (pluginManifestResult.isErr()) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                pluginManifestResult.unwrapErr());
+        }
+
+        std::filesystem::path outputBinary =
+            m_pSourcePath / pluginManifestResult.unwrap().getBinaryOutputPath();
+        std::optional<std::string> buildKey = getBuildKey(m_pSourcePath, name, hyprlandHeaders);
+
+        // Another instance already built and installed this exact revision
+        if (buildKey.has_value() && isInstalledBuild(outputBinary, buildKey.value())) {
+            debug("Reusing installed build of " + name);
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        std::optional<std::filesystem::path> sharedCache = getSharedCachePath();
+        std::optional<build::SToolchain> toolchain = build::getPluginToolchain(name);
+
+        // Profiles are per user, an instrumented binary writes into the profiles of whoever
+        // built it
+        if (!sharedCache.has_value() || !buildKey.has_value() ||
+            (toolchain.has_value() && toolchain->m_bPgo)) {
+            return buildPlugin(m_pSourcePath, name, hyprlandHeaders);
+        }
+
+        // Users building the same artifact wait for the first one and reuse its binary
+        std::string artifactKey = getArtifactKey(name, buildKey.value());
+        FileLock artifactLock =
+            FileLock(cache::getSharedLockPath(sharedCache.value(), hashString(artifactKey)));
+
+        if (std::filesystem::exists(cache::getArtifactPath(sharedCache.value(), artifactKey,
+                                                           outputBinary.filename().string()))) {
+            debug("Reusing shared build of " + name);
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        auto result = buildPlugin(m_pSourcePath, name, hyprlandHeaders);
+
+        if (result.isOk()) {
+            auto publishResult =
+                cache::publishArtifact(sharedCache.value(), artifactKey, outputBinary);
+
+            if (publishResult.isErr()) {
+                debug(publishResult.unwrapErr());
+            }
+        }
+
+        return result;
+    }
+
+    std::string GitPluginSource::getArtifactKey(const std::string& name,
+                                                const std::string& buildKey) const {
+        return m_sUrl + "\n" + m_sBranch + "\n" + name + "\n" + buildKey;
+    }
+
+    const std::filesystem::path& GitPluginSource::getSourcePath() const {
+        return m_pSourcePath;
     }
 
     bool GitPluginSource::isEquivalent(const PluginSource& other) const {
@@ -346,6 +904,20 @@ namespace hyprload::plugin {
         return true;
     }
 
+    std::string LocalPluginSource::getBinaryName(const std::string& name) const {
+        auto pluginManifest = getPluginManifest(m_pSourcePath, name);
+
+        if (pluginManifest.isErr()) {
+            return PluginSource::getBinaryName(name);
+        }
+
+        return pluginManifest.unwrap().getBinaryOutputPath().filename();
+    }
+
+    hyprload::Result<std::monostate, std::string> LocalPluginSource::pullSource() {
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
     hyprload::Result<std::monostate, std::string>
     LocalPluginSource::update(const std::string& name,
                               const std::filesystem::path& hyprlandHeaders) {
@@ -366,6 +938,14 @@ namespace hyprload::plugin {
             return result;
         }
 
+        return deploy(name, hyprlandHeaders);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    LocalPluginSource::deploy(const std::string& name,
+                              const std::filesystem::path& hyprlandHeaders) {
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
+
         auto pluginManifestResult = getPluginManifest(m_pSourcePath, name);
 
         if (pluginManifestResult.isErr()) {
@@ -375,28 +955,16 @@ namespace hyprload::plugin {
 
         const auto& pluginManifest = pluginManifestResult.unwrap();
 
-        std::filesystem::path outputBinary = m_pSourcePath / pluginManifest.getBinaryOutputPath();
-
-        if (!std::filesystem::exists(outputBinary)) {
-            return hyprload::Result<std::monostate, std::string>::err(
-                "Plugin binary does not exist");
-        }
-
-        std::filesystem::path targetPath =
-            hyprload::getPluginBinariesPath() / outputBinary.filename();
-
-        if (std::filesystem::exists(targetPath)) {
-            std::filesystem::remove(targetPath);
-        }
-
-        std::filesystem::copy(outputBinary, targetPath);
-
-        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        // Local sources are not versioned, so there is no build key to reuse
+        return installPluginBinary(m_pSourcePath / pluginManifest.getBinaryOutputPath(),
+                                   hyprlandHeaders, std::nullopt, pluginManifest.getDispatchers());
     }
 
     hyprload::Result<std::monostate, std::string>
     LocalPluginSource::build(const std::string& name,
                              const std::filesystem::path& hyprlandHeaders) {
+        FileLock sourceLock = FileLock(getPathLockFile("source", m_pSourcePath));
+
         return buildPlugin(m_pSourcePath, name, hyprlandHeaders);
     }
 
@@ -409,46 +977,63 @@ namespace hyprload::plugin {
     SelfSource::SelfSource() {}
 
     hyprload::Result<std::monostate, std::string> SelfSource::installSource() {
-        std::string command = "git clone https://github.com/Duckonaut/hyprload.git " +
-            getRootPath().string() + "/src";
+        FileLock sourceLock = FileLock(getPathLockFile("source", getSelfSourcePath()));
 
-        if (std::system(command.c_str()) != 0) {
-            return hyprload::Result<std::monostate, std::string>::err("Failed to clone own source");
+        if (isSourceAvailable()) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
         }
 
-        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        return git::getBackend().clone(c_selfUrl, "", getSelfSourcePath(), 0, false,
+                                       git::makeProgressReporter("Cloning hyprload"));
     }
 
     bool SelfSource::isSourceAvailable() {
-        return std::filesystem::exists(getRootPath() / "src" / ".git");
+        return std::filesystem::exists(getSelfSourcePath() / ".git");
     }
 
     bool SelfSource::isUpToDate() {
-        std::filesystem::path sourcePath = getRootPath() / "src";
-        std::string command = "git -C " + sourcePath.string() + " remote update";
+        std::optional<std::string> revision = getRevision();
 
-        if (std::system(command.c_str()) != 0) {
-            return false;
-        }
-
-        command = "git -C " + sourcePath.string() + " status -uno";
+        return revision.has_value() && revision == getRemoteRevision();
+    }
 
-        auto [exit, output] = executeCommand(command);
+    std::optional<std::string> SelfSource::getRevision() {
+        return git::getBackend().getHead(getSelfSourcePath());
+    }
 
-        return exit != 0 && output.find("behind") == std::string::npos;
+    std::optional<std::string> SelfSource::getRemoteRevision() {
+        return git::getBackend().lsRemote(c_selfUrl, "HEAD");
     }
 
     bool SelfSource::providesPlugin(const std::string&) const {
         return false; // Don't provide any plugins.
     }
 
+    hyprload::Result<std::monostate, std::string> SelfSource::pullSource() {
+        std::filesystem::path sourcePath = getSelfSourcePath();
+        FileLock sourceLock = FileLock(getPathLockFile("source", sourcePath));
+
+        if (wasPulledInRun(sourcePath)) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        auto result = fetchAndFastForward(sourcePath);
+
+        if (result.isErr()) {
+            return result;
+        }
+
+        markPulled(sourcePath);
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
     hyprload::Result<std::monostate, std::string>
     SelfSource::update(const std::string& name, const std::filesystem::path& hyprlandHeaders) {
-        std::string command = "git -C " + (getRootPath() / "src").string() + " pull";
+        auto result = pullSource();
 
-        if (std::system(command.c_str()) != 0) {
-            return hyprload::Result<std::monostate, std::string>::err(
-                "Failed to update own source");
+        if (result.isErr()) {
+            return result;
         }
 
         return this->install(name, hyprlandHeaders);
@@ -457,7 +1042,11 @@ namespace hyprload::plugin {
     hyprload::Result<std::monostate, std::string>
     SelfSource::install(const std::string& name, const std::filesystem::path& hyprlandHeaders) {
         if (!this->isSourceAvailable()) {
-            return this->installSource();
+            auto result = this->installSource();
+
+            if (result.isErr()) {
+                return result;
+            }
         }
 
         auto result = build(name, hyprlandHeaders);
@@ -466,13 +1055,22 @@ namespace hyprload::plugin {
             return result;
         }
 
+        return deploy(name, hyprlandHeaders);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    SelfSource::deploy(const std::string&, const std::filesystem::path&) {
+        // `make install` already stages the new binary for hyprload.sh to pick up
         return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
     }
 
     hyprload::Result<std::monostate, std::string>
     SelfSource::build(const std::string&, const std::filesystem::path& hyprlandHeaders) {
+        FileLock sourceLock = FileLock(getPathLockFile("source", getSelfSourcePath()));
+        FileLock headersLock = FileLock(getPathLockFile("headers", hyprlandHeaders), true);
+
         std::string buildSteps = "export HYPRLAND_HEADERS=" + hyprlandHeaders.string() +
-            " && make -C " + (getRootPath() / "src").string() + " install";
+            " && make -C " + getSelfSourcePath().string() + " install";
 
         auto [exit, output] = executeCommand(buildSteps);
 
@@ -547,6 +1145,22 @@ namespace hyprload::plugin {
         }
 
         m_pBinaryPath = hyprload::getPluginBinariesPath() / (m_sName + ".so");
+
+        if (plugin.contains("power_hungry") && plugin["power_hungry"].is_boolean()) {
+            m_bPowerHungry = plugin["power_hungry"].as_boolean()->get();
+        }
+
+        if (plugin.contains("lazy") && plugin["lazy"].is_boolean()) {
+            m_bLazy = plugin["lazy"].as_boolean()->get();
+        }
+
+        if (plugin.contains("idle_unload") && plugin["idle_unload"].is_integer()) {
+            m_iIdleUnload = std::max<i64>(plugin["idle_unload"].as_integer()->get(), 0);
+        }
+
+        if (plugin.contains("toolchain") && plugin["toolchain"].is_string()) {
+            m_sToolchain = plugin["toolchain"].as_string()->get();
+        }
     }
 
     PluginRequirement::PluginRequirement(const std::string& plugin) {
@@ -587,6 +1201,22 @@ namespace hyprload::plugin {
     }
 
     bool PluginRequirement::isInstalled() const {
-        return std::filesystem::exists(m_pBinaryPath);
+        return findInstalledBinary(m_pBinaryPath).has_value();
+    }
+
+    bool PluginRequirement::isPowerHungry() const {
+        return m_bPowerHungry;
+    }
+
+    bool PluginRequirement::isLazy() const {
+        return m_bLazy;
+    }
+
+    usize PluginRequirement::getIdleUnload() const {
+        return m_iIdleUnload;
+    }
+
+    const std::optional<std::string>& PluginRequirement::getToolchain() const {
+        return m_sToolchain;
     }
 }
@@ -0,0 +1,143 @@
+#include "Maintenance.hpp"
+#include "SystemMonitor.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <utility>
+
+#include <sys/wait.h>
+
+namespace hyprload::maintenance {
+    // prefetch keeps refs/prefetch close to the remote, so update fetches transfer little.
+    // loose-objects and incremental-repack fold objects into packs under a multi-pack-index,
+    // and commit-graph speeds up the history walks of fetch and status
+    const std::string c_maintenanceTasks =
+        "--task=prefetch --task=loose-objects --task=incremental-repack --task=commit-graph";
+
+    // The exit code of timeout(1) when the command ran out of time
+    constexpr int c_timeoutExitCode = 124;
+
+    std::filesystem::path getStampPath(const std::filesystem::path& repository) {
+        std::filesystem::path normalized = repository.lexically_normal();
+
+        return getStatePath() / "maintenance" /
+            (normalized.filename().string() + "." + hashString(normalized.string()).substr(0, 8));
+    }
+
+    std::vector<SRepository> findManagedRepositories() {
+        std::vector<SRepository> repositories = std::vector<SRepository>();
+        std::error_code ec;
+
+        for (const auto& entry : std::filesystem::directory_iterator(getPluginSourcesPath(), ec)) {
+            if (std::filesystem::exists(entry.path() / ".git")) {
+                repositories.push_back(SRepository{entry.path(), "source", false});
+            }
+        }
+
+        if (std::filesystem::exists(getSelfSourcePath() / ".git")) {
+            repositories.push_back(SRepository{getSelfSourcePath(), "source", false});
+        }
+
+        // Maintenance leaves the work tree alone, so builds may keep using the headers
+        if (std::filesystem::exists(getDefaultHyprlandHeadersPath() / ".git")) {
+            repositories.push_back(SRepository{getDefaultHyprlandHeadersPath(), "headers", true});
+        }
+
+        return repositories;
+    }
+
+    std::vector<SRepository> findDueRepositories(usize interval) {
+        auto now = std::filesystem::file_time_type::clock::now();
+        std::vector<std::pair<std::filesystem::file_time_type, SRepository>> due =
+            std::vector<std::pair<std::filesystem::file_time_type, SRepository>>();
+
+        for (SRepository& repository : findManagedRepositories()) {
+            std::error_code ec;
+            auto lastRun = std::filesystem::last_write_time(getStampPath(repository.m_pPath), ec);
+
+            if (ec) {
+                lastRun = std::filesystem::file_time_type::min();
+            } else if (now - lastRun < std::chrono::seconds(interval)) {
+                continue;
+            }
+
+            due.emplace_back(lastRun, std::move(repository));
+        }
+
+        std::sort(due.begin(), due.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::vector<SRepository> repositories = std::vector<SRepository>();
+
+        for (auto& [lastRun, repository] : due) {
+            repositories.push_back(std::move(repository));
+        }
+
+        return repositories;
+    }
+
+    RepositoryMaintenance::RepositoryMaintenance(std::vector<SRepository>&& repositories,
+                                                 usize timeLimit) {
+        m_vRepositories = std::move(repositories);
+        m_iTimeLimit = timeLimit;
+    }
+
+    void RepositoryMaintenance::run() {
+        system::setIdlePriority();
+
+        auto start = std::chrono::steady_clock::now();
+        SMaintenanceStats stats;
+
+        for (const SRepository& repository : m_vRepositories) {
+            usize elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+
+            if (elapsed >= m_iTimeLimit) {
+                stats.m_bTimedOut = true;
+                break;
+            }
+
+            // A repository in use is left for the next run instead of waiting on it
+            FileLock lock =
+                FileLock(getPathLockFile(repository.m_sLockPrefix, repository.m_pPath),
+                         repository.m_bSharedLock, false);
+
+            if (!lock.isLocked()) {
+                stats.m_iSkipped++;
+                continue;
+            }
+
+            std::string command = "timeout -k 5 " + std::to_string(m_iTimeLimit - elapsed) +
+                " git -C " + repository.m_pPath.string() +
+                " -c maintenance.auto=false maintenance run " + c_maintenanceTasks + " 2>&1";
+
+            auto [exit, output] = executeCommand(command);
+
+            if (WIFEXITED(exit) && WEXITSTATUS(exit) == c_timeoutExitCode) {
+                stats.m_bTimedOut = true;
+                break;
+            }
+
+            if (exit != 0) {
+                debug("Failed to maintain " + repository.m_pPath.string() + ": " + output);
+                stats.m_iSkipped++;
+                continue;
+            }
+
+            std::error_code ec;
+            std::filesystem::create_directories(getStampPath(repository.m_pPath).parent_path(),
+                                                ec);
+
+            std::ofstream stamp = std::ofstream(getStampPath(repository.m_pPath), std::ios::trunc);
+
+            stats.m_iMaintained++;
+        }
+
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        m_rResult = hyprload::Result<SMaintenanceStats, std::string>::ok(std::move(stats));
+    }
+}
@@ -0,0 +1,173 @@
+#include "Pgo.hpp"
+#include "GitBackend.hpp"
+#include "util.hpp"
+
+#include <fstream>
+
+namespace hyprload::pgo {
+    // Each holds the source revision it applies to. .instrumented is the installed
+    // instrumented build, .pending a profile of it awaiting its optimized build, and
+    // .collected a profile an optimized build succeeded with
+    const std::string c_instrumentedFile = ".instrumented";
+    const std::string c_pendingFile = ".pending";
+    const std::string c_collectedFile = ".collected";
+    const std::string c_mergedProfile = "default.profdata";
+
+    std::filesystem::path getProfilePath(const std::string& plugin) {
+        return getPluginProfilesPath() / plugin;
+    }
+
+    std::optional<std::string> readStamp(const std::string& plugin, const std::string& stamp) {
+        std::ifstream file = std::ifstream(getProfilePath(plugin) / stamp);
+        std::string revision;
+
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+
+        std::getline(file, revision);
+
+        return revision;
+    }
+
+    void writeStamp(const std::string& plugin, const std::string& stamp,
+                    const std::string& revision) {
+        std::ofstream file = std::ofstream(getProfilePath(plugin) / stamp, std::ios::trunc);
+
+        file << revision << '\n';
+    }
+
+    // Sources without git metadata have no revision, and keep their profile
+    std::string getRevision(const std::filesystem::path& sourcePath) {
+        return git::getBackend().getHead(sourcePath).value_or("");
+    }
+
+    ePhase getPhase(const std::string& plugin, const std::filesystem::path& sourcePath) {
+        std::string revision = getRevision(sourcePath);
+
+        if (readStamp(plugin, c_collectedFile) == revision ||
+            readStamp(plugin, c_pendingFile) == revision) {
+            return ePhase::USE;
+        }
+
+        return ePhase::GENERATE;
+    }
+
+    std::string appendFlags(const std::string& flags, const std::string& pgoFlags) {
+        return flags.empty() ? pgoFlags : flags + " " + pgoFlags;
+    }
+
+    build::SToolchain applyPhase(const std::string& plugin, ePhase phase,
+                                 const build::SToolchain& toolchain) {
+        // getProfilePath(), kept portable until the flags are exported
+        std::string profilePath = build::c_profilesPlaceholder + "/" + plugin;
+        // Both GCC and clang write into the directory given to -fprofile-generate, and read it
+        // back from -fprofile-use, clang from the default.profdata inside it.
+        // -fprofile-update=atomic keeps the counters of plugins with their own threads intact.
+        // Functions changed since the profile, like local edits, only lose their profile
+        // instead of failing the build
+        std::string pgoFlags = phase == ePhase::GENERATE ?
+            "-fprofile-generate=" + profilePath + " -fprofile-update=atomic" :
+            "-fprofile-use=" + profilePath +
+                " -Wno-error=coverage-mismatch -Wno-profile-instr-out-of-date";
+
+        build::SToolchain applied = toolchain;
+        applied.m_sCFlags = appendFlags(toolchain.m_sCFlags, pgoFlags);
+        applied.m_sCXXFlags = appendFlags(toolchain.m_sCXXFlags, pgoFlags);
+        // Links in the profiling runtime, and carries the profile into LTO
+        applied.m_sLDFlags = appendFlags(toolchain.m_sLDFlags, pgoFlags);
+
+        return applied;
+    }
+
+    bool hasFilesWithExtension(const std::filesystem::path& path, const std::string& extension) {
+        std::error_code ec;
+
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+            if (entry.path().extension() == extension) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    hyprload::Result<std::monostate, std::string> prepareBuild(const std::string& plugin,
+                                                               ePhase phase) {
+        std::filesystem::path profilePath = getProfilePath(plugin);
+        std::error_code ec;
+
+        if (phase == ePhase::GENERATE) {
+            // Counters of an older build would be merged into the new ones, or rejected
+            std::filesystem::remove_all(profilePath, ec);
+            std::filesystem::create_directories(profilePath, ec);
+
+            if (ec) {
+                return hyprload::Result<std::monostate, std::string>::err(
+                    "Failed to create " + profilePath.string() + ": " + ec.message());
+            }
+
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        if (!hasFilesWithExtension(profilePath, ".profraw") ||
+            std::filesystem::exists(profilePath / c_mergedProfile)) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        std::string command = "llvm-profdata merge -o " + (profilePath / c_mergedProfile).string() +
+            " " + profilePath.string() + "/*.profraw 2>&1";
+
+        auto [exit, output] = executeCommand(command);
+
+        if (exit != 0) {
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to merge the profile of " + plugin + ": " + output);
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+
+    void finishBuild(const std::string& plugin, const std::filesystem::path& sourcePath,
+                     ePhase phase, bool success) {
+        std::error_code ec;
+
+        if (phase == ePhase::GENERATE) {
+            if (success) {
+                writeStamp(plugin, c_instrumentedFile, getRevision(sourcePath));
+            }
+
+            return;
+        }
+
+        std::optional<std::string> pending = readStamp(plugin, c_pendingFile);
+
+        if (!pending.has_value()) {
+            return;
+        }
+
+        if (success) {
+            std::filesystem::rename(getProfilePath(plugin) / c_pendingFile,
+                                    getProfilePath(plugin) / c_collectedFile, ec);
+        } else {
+            std::filesystem::remove(getProfilePath(plugin) / c_pendingFile, ec);
+            std::filesystem::remove(getProfilePath(plugin) / c_mergedProfile, ec);
+        }
+    }
+
+    bool isCollecting(const std::string& plugin) {
+        std::optional<std::string> instrumented = readStamp(plugin, c_instrumentedFile);
+
+        return instrumented.has_value() && readStamp(plugin, c_pendingFile) != instrumented &&
+            readStamp(plugin, c_collectedFile) != instrumented;
+    }
+
+    bool hasProfileData(const std::string& plugin) {
+        return hasFilesWithExtension(getProfilePath(plugin), ".gcda") ||
+            hasFilesWithExtension(getProfilePath(plugin), ".profraw");
+    }
+
+    void requestOptimizedBuild(const std::string& plugin) {
+        writeStamp(plugin, c_pendingFile, readStamp(plugin, c_instrumentedFile).value_or(""));
+    }
+}
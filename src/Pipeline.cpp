@@ -0,0 +1,289 @@
+#include "Pipeline.hpp"
+#include "BuildProcessDescriptor.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+
+namespace hyprload::pipeline {
+    std::string getStageName(eStage stage) {
+        switch (stage) {
+            case eStage::RESOLVE: return "resolve";
+            case eStage::FETCH: return "fetch";
+            case eStage::WAIT_HEADERS: return "prepare headers for";
+            case eStage::BUILD: return "build";
+            case eStage::INSTALL: return "install";
+            case eStage::LOAD: return "load";
+            case eStage::DECOMPRESS: return "decompress";
+        }
+
+        return "process";
+    }
+
+    Pipeline& Pipeline::addStage(eStage stage, eResource resource, StageFunction&& run) {
+        m_vStages.push_back(SStage{stage, resource, std::move(run)});
+
+        return *this;
+    }
+
+    const std::vector<SStage>& Pipeline::getStages() const {
+        return m_vStages;
+    }
+
+    void finishJob(BuildProcessDescriptor& descriptor,
+                   hyprload::Result<eOutcome, std::string>&& result) {
+        auto lock = std::scoped_lock<std::mutex>(descriptor.m_mMutex);
+
+        descriptor.m_rResult = std::move(result);
+    }
+
+    Executor::Executor() {
+        m_pState = std::make_shared<SState>();
+
+        usize cores = std::max(1u, std::thread::hardware_concurrency());
+
+        m_pState->m_mLimits[eResource::NETWORK] = 4;
+        m_pState->m_mLimits[eResource::CPU] = std::max<usize>(1, cores / 2);
+        m_pState->m_mLimits[eResource::LOADING] = std::max<usize>(1, cores / 2);
+        m_pState->m_mLimits[eResource::MAIN_THREAD] = 1;
+    }
+
+    Executor::~Executor() {
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+            m_pState->m_bStopping = true;
+            m_pState->m_cvWork.notify_all();
+        }
+
+        // Workers in the middle of a stage finish it first
+        for (std::thread& worker : m_vWorkers) {
+            worker.join();
+        }
+    }
+
+    void Executor::setResourceLimit(eResource resource, usize limit) {
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+            m_pState->m_mLimits[resource] = std::max<usize>(1, limit);
+            m_pState->m_cvWork.notify_all();
+        }
+
+        ensureWorkers();
+    }
+
+    void Executor::setResourcePaused(eResource resource, bool paused) {
+        auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+        m_pState->m_mPaused[resource] = paused;
+        m_pState->m_cvWork.notify_all();
+    }
+
+    void Executor::submit(std::shared_ptr<const Pipeline> pipeline,
+                          std::shared_ptr<BuildProcessDescriptor> descriptor) {
+        if (pipeline->getStages().empty()) {
+            finishJob(*descriptor, hyprload::Result<eOutcome, std::string>::ok(eOutcome::UPDATED));
+            return;
+        }
+
+        ensureWorkers();
+
+        enqueue(m_pState, STask{std::move(pipeline), std::move(descriptor), 0});
+    }
+
+    void Executor::post(eStage stage, eResource resource, std::string&& name,
+                        std::function<void()>&& job) {
+        auto pipeline = std::make_shared<Pipeline>();
+
+        pipeline->addStage(stage, resource,
+                           [job = std::move(job)](BuildProcessDescriptor&) -> StageResult {
+                               job();
+
+                               return StageResult::ok(eStageFlow::NEXT);
+                           });
+
+        submit(pipeline, std::make_shared<BuildProcessDescriptor>(std::move(name), nullptr,
+                                                                  std::filesystem::path()));
+    }
+
+    void Executor::wake() {
+        std::vector<STask> parked = std::vector<STask>();
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+            m_pState->m_iWakeGeneration++;
+            parked.swap(m_pState->m_vParked);
+        }
+
+        for (STask& task : parked) {
+            enqueue(m_pState, std::move(task));
+        }
+    }
+
+    void Executor::runMainThreadTasks() {
+        std::vector<STask> tasks = std::vector<STask>();
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+            usize limit = m_pState->m_mLimits[eResource::MAIN_THREAD];
+
+            while (!m_pState->m_dMainThreadQueue.empty() && tasks.size() < limit) {
+                tasks.push_back(std::move(m_pState->m_dMainThreadQueue.front()));
+                m_pState->m_dMainThreadQueue.pop_front();
+            }
+        }
+
+        for (STask& task : tasks) {
+            runTask(m_pState, std::move(task));
+        }
+    }
+
+    void Executor::ensureWorkers() {
+        auto lock = std::scoped_lock<std::mutex>(m_pState->m_mMutex);
+
+        // One worker per network, CPU and loading slot, and some for stages that need none
+        usize wanted = m_pState->m_mLimits[eResource::NETWORK] +
+            m_pState->m_mLimits[eResource::CPU] + m_pState->m_mLimits[eResource::LOADING] + 2;
+
+        while (m_pState->m_iWorkers < wanted) {
+            m_vWorkers.emplace_back(&Executor::workerLoop, m_pState);
+
+            m_pState->m_iWorkers++;
+        }
+    }
+
+    void Executor::workerLoop(std::shared_ptr<SState> state) {
+        std::unique_lock<std::mutex> lock = std::unique_lock(state->m_mMutex);
+
+        while (true) {
+            auto next = state->m_dQueue.end();
+
+            state->m_cvWork.wait(lock, [&state, &next]() {
+                if (state->m_bStopping) {
+                    return true;
+                }
+
+                next = std::find_if(state->m_dQueue.begin(), state->m_dQueue.end(),
+                                    [&state](const STask& task) {
+                                        return isRunnable(*state, task);
+                                    });
+
+                return next != state->m_dQueue.end();
+            });
+
+            if (state->m_bStopping) {
+                state->m_iWorkers--;
+                return;
+            }
+
+            STask task = std::move(*next);
+            state->m_dQueue.erase(next);
+
+            eResource resource = task.m_pPipeline->getStages()[task.m_iStage].m_eResource;
+            state->m_mInUse[resource]++;
+
+            lock.unlock();
+            runTask(state, std::move(task));
+            lock.lock();
+
+            state->m_mInUse[resource]--;
+            state->m_cvWork.notify_all();
+        }
+    }
+
+    void Executor::runTask(const std::shared_ptr<SState>& state, STask&& task) {
+        const SStage& stage = task.m_pPipeline->getStages()[task.m_iStage];
+        BuildProcessDescriptor& descriptor = *task.m_pDescriptor;
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(descriptor.m_mMutex);
+
+            descriptor.m_eStage = stage.m_eStage;
+        }
+
+        usize wakeGeneration = 0;
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(state->m_mMutex);
+
+            wakeGeneration = state->m_iWakeGeneration;
+        }
+
+        std::optional<StageResult> result = std::nullopt;
+
+        try {
+            result = stage.m_fnRun(descriptor);
+        } catch (const std::exception& e) {
+            result = StageResult::err(std::string(e.what()));
+        }
+
+        if (result.value().isErr()) {
+            finishJob(descriptor,
+                      hyprload::Result<eOutcome, std::string>::err(
+                          "Failed to " + getStageName(stage.m_eStage) + " " +
+                          descriptor.m_sName + ": " + result.value().unwrapErr()));
+            return;
+        }
+
+        switch (result.value().unwrap()) {
+            case eStageFlow::NEXT:
+                task.m_iStage++;
+
+                if (task.m_iStage >= task.m_pPipeline->getStages().size()) {
+                    finishJob(descriptor,
+                              hyprload::Result<eOutcome, std::string>::ok(eOutcome::UPDATED));
+                    return;
+                }
+
+                enqueue(state, std::move(task));
+                return;
+            case eStageFlow::PENDING: {
+                std::unique_lock<std::mutex> lock = std::unique_lock(state->m_mMutex);
+
+                // A wake() while the stage ran would never reach a job parked after it
+                if (state->m_iWakeGeneration != wakeGeneration) {
+                    lock.unlock();
+                    enqueue(state, std::move(task));
+                    return;
+                }
+
+                state->m_vParked.push_back(std::move(task));
+                return;
+            }
+            case eStageFlow::UP_TO_DATE:
+                finishJob(descriptor,
+                          hyprload::Result<eOutcome, std::string>::ok(eOutcome::UP_TO_DATE));
+                return;
+        }
+    }
+
+    void Executor::enqueue(const std::shared_ptr<SState>& state, STask&& task) {
+        auto lock = std::scoped_lock<std::mutex>(state->m_mMutex);
+
+        if (task.m_pPipeline->getStages()[task.m_iStage].m_eResource == eResource::MAIN_THREAD) {
+            state->m_dMainThreadQueue.push_back(std::move(task));
+            return;
+        }
+
+        state->m_dQueue.push_back(std::move(task));
+        state->m_cvWork.notify_all();
+    }
+
+    bool Executor::isRunnable(SState& state, const STask& task) {
+        eResource resource = task.m_pPipeline->getStages()[task.m_iStage].m_eResource;
+
+        if (resource == eResource::NONE) {
+            return true;
+        }
+
+        if (state.m_mPaused[resource]) {
+            return false;
+        }
+
+        return state.m_mInUse[resource] < state.m_mLimits[resource];
+    }
+}
@@ -0,0 +1,65 @@
+#include "PowerPolicy.hpp"
+#include "SystemMonitor.hpp"
+#include "util.hpp"
+
+namespace hyprload::power {
+    constexpr auto c_pollInterval = std::chrono::seconds(10);
+    // Degrees a zone has to cool below a threshold before it counts as under it again
+    constexpr f64 c_thermalHysteresis = 5.0;
+
+    bool PowerPolicy::poll() {
+        auto now = std::chrono::steady_clock::now();
+
+        if (now < m_tNextPoll) {
+            return false;
+        }
+
+        m_tNextPoll = now + c_pollInterval;
+
+        m_sState.m_bOnAc = system::isOnAcPower();
+        m_sState.m_fTemperature = system::getTemperature();
+
+        bool onBattery = !m_sState.m_bOnAc;
+
+        bool deferBuilds = (isDeferBuildsOnBattery() && onBattery) ||
+            isAbove(getDeferBuildsTemperature(), m_bDeferBuilds);
+        bool limitBuilds = isAbove(getLimitBuildsTemperature(), m_bLimitBuilds);
+        bool unloadPowerHungry = isUnloadPowerHungry() && onBattery;
+
+        bool changed = deferBuilds != m_bDeferBuilds || limitBuilds != m_bLimitBuilds ||
+            unloadPowerHungry != m_bUnloadPowerHungry;
+
+        m_bDeferBuilds = deferBuilds;
+        m_bLimitBuilds = limitBuilds;
+        m_bUnloadPowerHungry = unloadPowerHungry;
+
+        return changed;
+    }
+
+    bool PowerPolicy::shouldDeferBuilds() const {
+        return m_bDeferBuilds;
+    }
+
+    bool PowerPolicy::shouldLimitBuilds() const {
+        return m_bLimitBuilds;
+    }
+
+    bool PowerPolicy::shouldUnloadPowerHungry() const {
+        return m_bUnloadPowerHungry;
+    }
+
+    const SPowerState& PowerPolicy::getState() const {
+        return m_sState;
+    }
+
+    bool PowerPolicy::isAbove(usize threshold, bool wasAbove) const {
+        if (threshold == 0 || !m_sState.m_fTemperature.has_value()) {
+            return false;
+        }
+
+        f64 temperature = m_sState.m_fTemperature.value();
+
+        return wasAbove ? temperature >= threshold - c_thermalHysteresis :
+                          temperature >= threshold;
+    }
+}
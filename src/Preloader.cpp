@@ -0,0 +1,223 @@
+#include "Preloader.hpp"
+#include "Compression.hpp"
+#include "Pipeline.hpp"
+#include "util.hpp"
+
+#include <utility>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace hyprload::preload {
+    // RTLD_NOW binds every symbol here instead of on first call, and a later dlopen of the
+    // same path returns this object whatever flags it passes
+    void* openBinary(const std::string& plugin, const std::filesystem::path& path) {
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+        if (!handle) {
+            debug("Failed to preload " + plugin + ": " + std::string(dlerror()));
+        }
+
+        return handle;
+    }
+
+    Preloader::Preloader(std::vector<SPreloadRequest>&& plugins, PreflightCheck&& preflightCheck,
+                         const std::filesystem::path& stagingPath) {
+        m_vPlugins = std::move(plugins);
+        m_fnPreflightCheck = std::move(preflightCheck);
+        m_pStagingPath = stagingPath;
+    }
+
+    Preloader::~Preloader() {
+        if (m_tThread.joinable()) {
+            m_tThread.join();
+        }
+    }
+
+    void Preloader::start() {
+        std::vector<SPreloadRequest> compressed = std::vector<SPreloadRequest>();
+
+        std::erase_if(m_vPlugins, [&compressed](SPreloadRequest& request) {
+            if (!compression::isCompressed(request.m_pPath)) {
+                return false;
+            }
+
+            compressed.push_back(std::move(request));
+            return true;
+        });
+
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+            m_iPending = m_vPlugins.empty() ? 0 : 1;
+            m_bDone = m_iPending == 0;
+        }
+
+        if (!m_vPlugins.empty()) {
+            m_tThread = std::thread([this]() { run(); });
+        }
+
+        for (SPreloadRequest& request : compressed) {
+            add(std::move(request));
+        }
+    }
+
+    void Preloader::add(SPreloadRequest&& request) {
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+            m_iPending++;
+            m_bDone = false;
+        }
+
+        std::string name = request.m_sPlugin;
+
+        pipeline::g_pExecutor->post(
+            pipeline::eStage::DECOMPRESS, pipeline::eResource::LOADING, std::move(name),
+            [preloader = shared_from_this(), request = std::move(request)]() {
+                preloader->decompress(request);
+            });
+    }
+
+    void Preloader::run() {
+        for (const SPreloadRequest& request : m_vPlugins) {
+            {
+                auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+                if (m_bCancelled) {
+                    break;
+                }
+            }
+
+            SPreloaded preloaded = SPreloaded{request.m_sPlugin, request.m_pPath, request.m_pPath};
+            preloaded.m_bReload = request.m_bReload;
+
+            if (request.m_bOpen) {
+                preloaded.m_pHandle = openBinary(request.m_sPlugin, request.m_pPath);
+            }
+
+            finish(std::move(preloaded));
+        }
+
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        m_iPending--;
+        m_bDone = m_iPending == 0;
+    }
+
+    void Preloader::decompress(const SPreloadRequest& request) {
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+            if (m_bCancelled) {
+                m_iPending--;
+                m_bDone = m_iPending == 0;
+                return;
+            }
+        }
+
+        SPreloaded preloaded = SPreloaded{request.m_sPlugin, request.m_pPath, request.m_pPath};
+        preloaded.m_bReload = request.m_bReload;
+
+        auto decompressed = compression::decompressToMemory(request.m_pPath);
+
+        if (decompressed.isErr()) {
+            preloaded.m_sError = decompressed.unwrapErr();
+        } else {
+            preloaded.m_iMemoryFile = decompressed.unwrap();
+            preloaded.m_pPath = compression::getMemoryFilePath(decompressed.unwrap());
+
+            // The same check loadPlugins() runs on staged binaries, before anything of the
+            // binary runs
+            auto preflight = m_fnPreflightCheck(preloaded.m_pPath);
+
+            if (preflight.isErr()) {
+                preloaded.m_sError = preflight.unwrapErr();
+                preloaded.m_bRefused = true;
+            } else if (!compression::isExecutable(decompressed.unwrap())) {
+                decompressToFile(request, preloaded);
+            } else if (request.m_bOpen) {
+                preloaded.m_pHandle = openBinary(request.m_sPlugin, preloaded.m_pPath);
+
+                // Executable, but mounted or sealed noexec in some other way
+                if (!preloaded.m_pHandle) {
+                    decompressToFile(request, preloaded);
+                }
+            }
+        }
+
+        finish(std::move(preloaded));
+
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        m_iPending--;
+        m_bDone = m_iPending == 0;
+    }
+
+    void Preloader::decompressToFile(const SPreloadRequest& request, SPreloaded& preloaded) {
+        debug("Memory files are not executable, decompressing " + request.m_sPlugin +
+              " to a file");
+
+        auto decompressed = compression::decompressToFile(request.m_pPath, m_pStagingPath);
+
+        close(preloaded.m_iMemoryFile.value());
+        preloaded.m_iMemoryFile = std::nullopt;
+
+        if (decompressed.isErr()) {
+            preloaded.m_sError = decompressed.unwrapErr();
+            return;
+        }
+
+        preloaded.m_pPath = decompressed.unwrap();
+        preloaded.m_bDecompressedFile = true;
+
+        if (request.m_bOpen) {
+            preloaded.m_pHandle = openBinary(request.m_sPlugin, preloaded.m_pPath);
+        }
+    }
+
+    void Preloader::finish(SPreloaded&& preloaded) {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        if (m_bCancelled) {
+            release(preloaded);
+            return;
+        }
+
+        m_vReady.push_back(std::move(preloaded));
+    }
+
+    void Preloader::cancel() {
+        {
+            auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+            m_bCancelled = true;
+
+            for (const SPreloaded& preloaded : m_vReady) {
+                release(preloaded);
+            }
+
+            m_vReady.clear();
+        }
+
+        // At most the binary being opened right now is left to finish, run() releases it
+        if (m_tThread.joinable()) {
+            m_tThread.join();
+        }
+    }
+
+    void release(const SPreloaded& preloaded) {
+        if (preloaded.m_pHandle) {
+            dlclose(preloaded.m_pHandle);
+        }
+
+        if (preloaded.m_iMemoryFile.has_value()) {
+            close(preloaded.m_iMemoryFile.value());
+        }
+
+        if (preloaded.m_bDecompressedFile) {
+            std::error_code ec;
+            std::filesystem::remove_all(preloaded.m_pPath.parent_path(), ec);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#include "SharedCache.hpp"
+#include "util.hpp"
+
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+namespace hyprload::cache {
+    std::filesystem::path getSharedHeadersPath(const std::filesystem::path& sharedCache,
+                                               const std::string& commit) {
+        return sharedCache / "headers" / commit;
+    }
+
+    std::filesystem::path getArtifactPath(const std::filesystem::path& sharedCache,
+                                          const std::string& key, const std::string& filename) {
+        return sharedCache / "artifacts" / hashString(key) / filename;
+    }
+
+    std::filesystem::path getSharedLockPath(const std::filesystem::path& sharedCache,
+                                            const std::string& name) {
+        createSharedDirectory(sharedCache / "locks");
+
+        return sharedCache / "locks" / (name + ".lock");
+    }
+
+    void createSharedDirectory(const std::filesystem::path& path) {
+        std::error_code ec;
+
+        if (std::filesystem::exists(path, ec)) {
+            return;
+        }
+
+        createSharedDirectory(path.parent_path());
+
+        std::filesystem::create_directory(path, ec);
+        std::filesystem::permissions(path,
+                                     std::filesystem::perms::owner_all |
+                                         std::filesystem::perms::group_all |
+                                         std::filesystem::perms::set_gid,
+                                     ec);
+    }
+
+    hyprload::Result<std::monostate, std::string>
+    publishArtifact(const std::filesystem::path& sharedCache, const std::string& key,
+                    const std::filesystem::path& binary) {
+        std::filesystem::path artifact =
+            getArtifactPath(sharedCache, key, binary.filename().string());
+
+        if (std::filesystem::exists(artifact)) {
+            return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+        }
+
+        createSharedDirectory(artifact.parent_path().parent_path());
+
+        std::filesystem::path stagingPath = artifact.parent_path();
+        stagingPath += ".tmp." + std::to_string(getpid());
+
+        std::error_code ec;
+        std::filesystem::remove_all(stagingPath, ec);
+        createSharedDirectory(stagingPath);
+
+        std::filesystem::copy_file(binary, stagingPath / binary.filename(), ec);
+
+        if (!ec) {
+            std::filesystem::permissions(stagingPath / binary.filename(),
+                                         std::filesystem::perms::group_read |
+                                             std::filesystem::perms::group_write,
+                                         std::filesystem::perm_options::add, ec);
+        }
+
+        if (!ec) {
+            std::filesystem::rename(stagingPath, artifact.parent_path(), ec);
+        }
+
+        if (ec) {
+            std::filesystem::remove_all(stagingPath, ec);
+
+            // Losing the race against another publisher is fine, the contents are the same
+            if (std::filesystem::exists(artifact)) {
+                return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+            }
+
+            return hyprload::Result<std::monostate, std::string>::err(
+                "Failed to publish " + binary.filename().string() + " to the shared cache");
+        }
+
+        return hyprload::Result<std::monostate, std::string>::ok(std::monostate());
+    }
+}
@@ -0,0 +1,218 @@
+#include "SystemMonitor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hyprload::system {
+    const std::filesystem::path c_powerSupplyPath = "/sys/class/power_supply";
+    const std::filesystem::path c_thermalPath = "/sys/class/thermal";
+    const std::filesystem::path c_atomCpusPath = "/sys/devices/cpu_atom/cpus";
+    const std::filesystem::path c_cpusPath = "/sys/devices/system/cpu";
+    const std::filesystem::path c_cpuinfoPath = "/proc/cpuinfo";
+
+    // From linux/ioprio.h, which not every libc ships
+    constexpr int c_ioprioWhoProcess = 1;
+    constexpr int c_ioprioIdle = 3 << 13;
+
+    std::string readAttribute(const std::filesystem::path& path) {
+        std::ifstream file = std::ifstream(path);
+        std::string value;
+
+        std::getline(file, value);
+
+        return value;
+    }
+
+    bool isOnAcPower() {
+        std::error_code ec;
+        bool hasMains = false;
+        bool discharging = false;
+
+        for (const auto& entry : std::filesystem::directory_iterator(c_powerSupplyPath, ec)) {
+            std::string type = readAttribute(entry.path() / "type");
+
+            if (type == "Mains") {
+                if (readAttribute(entry.path() / "online") == "1") {
+                    return true;
+                }
+
+                hasMains = true;
+            } else if (type == "Battery") {
+                discharging = discharging ||
+                    readAttribute(entry.path() / "status") == "Discharging";
+            }
+        }
+
+        return !hasMains && !discharging;
+    }
+
+    std::optional<f64> getTemperature() {
+        std::error_code ec;
+        std::optional<f64> hottest = std::nullopt;
+
+        for (const auto& entry : std::filesystem::directory_iterator(c_thermalPath, ec)) {
+            if (entry.path().filename().string().rfind("thermal_zone", 0) != 0) {
+                continue;
+            }
+
+            // Millidegrees, zones without a sensor report errors or nonsense
+            f64 temperature = std::atof(readAttribute(entry.path() / "temp").c_str()) / 1000.0;
+
+            if (temperature <= 0 || temperature > 150) {
+                continue;
+            }
+
+            hottest = std::max(hottest.value_or(temperature), temperature);
+        }
+
+        return hottest;
+    }
+
+    bool isIdle() {
+        f64 load[1];
+
+        if (getloadavg(load, 1) != 1) {
+            return false;
+        }
+
+        return load[0] < std::max(1u, std::thread::hardware_concurrency()) / 4.0;
+    }
+
+    std::optional<std::string> getCpuModel() {
+        std::ifstream file = std::ifstream(c_cpuinfoPath);
+        std::string line;
+
+        while (std::getline(file, line)) {
+            if (line.rfind("model name", 0) != 0) {
+                continue;
+            }
+
+            // "model name\t: <model>"
+            usize value = line.find_first_not_of(" \t", line.find(':') + 1);
+
+            if (line.find(':') == std::string::npos || value == std::string::npos) {
+                return std::nullopt;
+            }
+
+            return line.substr(value);
+        }
+
+        return std::nullopt;
+    }
+
+    // Kernel CPU lists, e.g. 0-3,8,10-11
+    std::vector<usize> parseCpuList(const std::string& list) {
+        std::vector<usize> cpus = std::vector<usize>();
+        std::istringstream stream = std::istringstream(list);
+        std::string range;
+
+        while (std::getline(stream, range, ',')) {
+            usize dash = range.find('-');
+            usize first = std::strtoul(range.c_str(), nullptr, 10);
+            usize last = dash == std::string::npos ?
+                first :
+                std::strtoul(range.c_str() + dash + 1, nullptr, 10);
+
+            for (usize cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        return cpus;
+    }
+
+    std::optional<std::vector<usize>> findEfficiencyCpus() {
+        std::string atomCpus = readAttribute(c_atomCpusPath);
+
+        if (!atomCpus.empty()) {
+            return parseCpuList(atomCpus);
+        }
+
+        std::vector<std::pair<usize, usize>> capacities = std::vector<std::pair<usize, usize>>();
+        std::error_code ec;
+
+        for (const auto& entry : std::filesystem::directory_iterator(c_cpusPath, ec)) {
+            std::string name = entry.path().filename();
+            std::string capacity = readAttribute(entry.path() / "cpu_capacity");
+
+            if (name.rfind("cpu", 0) != 0 || name.size() == 3 ||
+                !std::all_of(name.begin() + 3, name.end(), ::isdigit) || capacity.empty()) {
+                continue;
+            }
+
+            capacities.emplace_back(std::strtoul(name.c_str() + 3, nullptr, 10),
+                                    std::strtoul(capacity.c_str(), nullptr, 10));
+        }
+
+        if (capacities.empty()) {
+            return std::nullopt;
+        }
+
+        usize maxCapacity = 0;
+
+        for (const auto& [cpu, capacity] : capacities) {
+            maxCapacity = std::max(maxCapacity, capacity);
+        }
+
+        std::vector<usize> cpus = std::vector<usize>();
+
+        for (const auto& [cpu, capacity] : capacities) {
+            if (capacity < maxCapacity) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        if (cpus.empty()) {
+            return std::nullopt;
+        }
+
+        std::sort(cpus.begin(), cpus.end());
+
+        return cpus;
+    }
+
+    std::optional<std::vector<usize>> getEfficiencyCpus() {
+        // Topology does not change while running
+        static std::optional<std::vector<usize>> efficiencyCpus = findEfficiencyCpus();
+
+        return efficiencyCpus;
+    }
+
+    ScopedAffinity::ScopedAffinity(const std::vector<usize>& cpus) {
+        if (pthread_getaffinity_np(pthread_self(), sizeof(m_sPrevious), &m_sPrevious) != 0) {
+            return;
+        }
+
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+
+        for (usize cpu : cpus) {
+            CPU_SET(cpu, &affinity);
+        }
+
+        m_bApplied = pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity) == 0;
+    }
+
+    ScopedAffinity::~ScopedAffinity() {
+        if (m_bApplied) {
+            pthread_setaffinity_np(pthread_self(), sizeof(m_sPrevious), &m_sPrevious);
+        }
+    }
+
+    void setIdlePriority() {
+        // Both only apply to the given thread id, not the whole compositor
+        setpriority(PRIO_PROCESS, gettid(), 19);
+        syscall(SYS_ioprio_set, c_ioprioWhoProcess, gettid(), c_ioprioIdle);
+    }
+}
@@ -0,0 +1,240 @@
+#include "UpdateChecker.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+#include "toml/toml.hpp"
+
+namespace hyprload::updates {
+    std::filesystem::path getUpdateCachePath() {
+        return getStatePath() / "updates.toml";
+    }
+
+    std::optional<std::string> UpdateCache::getFreshRemoteRevision(const std::string& name) {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        i64 interval = getUpdateCheckInterval();
+        auto check = m_mChecks.find(name);
+
+        if (interval == 0 || check == m_mChecks.end() ||
+            std::time(nullptr) - check->second.m_iCheckedAt >= interval) {
+            return std::nullopt;
+        }
+
+        return check->second.m_sRemote;
+    }
+
+    void UpdateCache::recordCheck(const std::string& name, SRevisionCheck&& check) {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        m_mChecks[name] = std::move(check);
+
+        save();
+    }
+
+    void UpdateCache::recordRevision(const std::string& name, const std::string& revision) {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        auto check = m_mChecks.find(name);
+
+        if (check == m_mChecks.end() || check->second.m_sLocal == revision) {
+            return;
+        }
+
+        check->second.m_sLocal = revision;
+
+        save();
+    }
+
+    void UpdateCache::recordFullCheck(std::unordered_map<std::string, SRevisionCheck>&& checks,
+                                      const std::unordered_set<std::string>& checked) {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        std::erase_if(m_mChecks, [&checked](const auto& check) {
+            return !checked.contains(check.first);
+        });
+
+        for (auto& [name, check] : checks) {
+            m_mChecks[name] = std::move(check);
+        }
+
+        m_iLastCheck = std::time(nullptr);
+
+        save();
+    }
+
+    std::vector<std::string> UpdateCache::getAvailableUpdates() {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        std::vector<std::string> available = std::vector<std::string>();
+
+        for (const auto& [name, check] : m_mChecks) {
+            if (check.m_sLocal != check.m_sRemote) {
+                available.push_back(name);
+            }
+        }
+
+        std::sort(available.begin(), available.end());
+
+        return available;
+    }
+
+    usize UpdateCache::getAvailableUpdateCount() {
+        return m_iAvailableUpdates.load();
+    }
+
+    std::optional<i64> UpdateCache::getLastCheckTime() {
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+        load();
+
+        return m_iLastCheck;
+    }
+
+    void UpdateCache::load() {
+        if (m_bLoaded) {
+            return;
+        }
+
+        m_bLoaded = true;
+
+        if (!std::filesystem::exists(getUpdateCachePath())) {
+            return;
+        }
+
+        toml::table cache;
+
+        try {
+            cache = toml::parse_file(getUpdateCachePath().string());
+        } catch (const std::exception& e) {
+            debug("Ignoring unreadable update cache: " + std::string(e.what()));
+            return;
+        }
+
+        m_iLastCheck = cache["last_check"].value<i64>();
+
+        const toml::table* plugins = cache["plugins"].as_table();
+
+        if (!plugins) {
+            return;
+        }
+
+        for (const auto& [name, entry] : *plugins) {
+            const toml::table* table = entry.as_table();
+
+            if (!table) {
+                continue;
+            }
+
+            auto checkedAt = (*table)["checked"].value<i64>();
+            auto local = (*table)["local"].value<std::string>();
+            auto remote = (*table)["remote"].value<std::string>();
+
+            if (!checkedAt.has_value() || !local.has_value() || !remote.has_value()) {
+                continue;
+            }
+
+            m_mChecks[std::string(name.str())] =
+                SRevisionCheck{checkedAt.value(), local.value(), remote.value()};
+        }
+
+        countAvailableUpdates();
+    }
+
+    void UpdateCache::save() {
+        toml::table plugins;
+
+        for (const auto& [name, check] : m_mChecks) {
+            plugins.insert(name, toml::table{
+                                     {"checked", check.m_iCheckedAt},
+                                     {"local", check.m_sLocal},
+                                     {"remote", check.m_sRemote},
+                                 });
+        }
+
+        toml::table cache;
+        cache.insert("plugins", std::move(plugins));
+
+        if (m_iLastCheck.has_value()) {
+            cache.insert("last_check", m_iLastCheck.value());
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(getStatePath(), ec);
+
+        // Instances sharing the cache may read it at any time, so never leave it half written
+        std::filesystem::path tmpPath = getUpdateCachePath();
+        tmpPath += ".tmp." + std::to_string(getpid());
+
+        {
+            std::ofstream file = std::ofstream(tmpPath, std::ios::trunc);
+            file << cache << std::endl;
+        }
+
+        std::filesystem::rename(tmpPath, getUpdateCachePath(), ec);
+
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+        }
+
+        countAvailableUpdates();
+    }
+
+    void UpdateCache::countAvailableUpdates() {
+        m_iAvailableUpdates =
+            std::count_if(m_mChecks.begin(), m_mChecks.end(), [](const auto& check) {
+                return check.second.m_sLocal != check.second.m_sRemote;
+            });
+    }
+
+    UpdateCheck::UpdateCheck(
+        std::vector<std::pair<std::string, std::shared_ptr<plugin::PluginSource>>>&& sources) {
+        m_vSources = std::move(sources);
+    }
+
+    void UpdateCheck::check() {
+        std::unordered_map<std::string, SRevisionCheck> checks =
+            std::unordered_map<std::string, SRevisionCheck>();
+        std::unordered_set<std::string> checked = std::unordered_set<std::string>();
+
+        for (auto& [name, source] : m_vSources) {
+            checked.insert(name);
+
+            if (!source->isSourceAvailable()) {
+                continue;
+            }
+
+            std::optional<std::string> local = source->getRevision();
+
+            // Unversioned sources have nothing to compare
+            if (!local.has_value()) {
+                continue;
+            }
+
+            std::optional<std::string> remote = source->getRemoteRevision();
+
+            if (!remote.has_value()) {
+                continue;
+            }
+
+            checks[name] = SRevisionCheck{std::time(nullptr), local.value(), remote.value()};
+        }
+
+        g_pUpdateCache->recordFullCheck(std::move(checks), checked);
+
+        usize available = g_pUpdateCache->getAvailableUpdateCount();
+
+        auto lock = std::scoped_lock<std::mutex>(m_mMutex);
+
+        m_iResult = available;
+    }
+}
@@ -19,6 +19,9 @@
 #include "Hyprload.hpp"
 #include "HyprloadOverlay.hpp"
 #include "HyprloadConfig.hpp"
+#include "Pipeline.hpp"
+#include "PowerPolicy.hpp"
+#include "UpdateChecker.hpp"
 
 inline CFunctionHook* g_pRenderAllClientsForMonitorHook = nullptr;
 typedef void (*origRenderAllClientsForMonitor)(void*, const int&, timespec*);
@@ -45,6 +48,13 @@ void hkWlTick(void* thisptr) {
 }
 
 void hyprloadDispatcher(std::string command) {
+    std::optional<std::string> argument = std::nullopt;
+
+    if (usize space = command.find(' '); space != std::string::npos) {
+        argument = command.substr(space + 1);
+        command = command.substr(0, space);
+    }
+
     if (command == "load") {
         hyprload::g_pHyprload->loadPlugins();
     } else if (command == "clear") {
@@ -52,9 +62,15 @@ void hyprloadDispatcher(std::string command) {
     } else if (command == "reload") {
         hyprload::g_pHyprload->reloadPlugins();
     } else if (command == "install") {
-        hyprload::g_pHyprload->installPlugins();
+        hyprload::g_pHyprload->installPlugins(argument);
     } else if (command == "update") {
-        hyprload::g_pHyprload->updatePlugins();
+        hyprload::g_pHyprload->updatePlugins(argument);
+    } else if (command == "profile") {
+        hyprload::g_pHyprload->switchProfile(argument);
+    } else if (command == "gc") {
+        hyprload::g_pHyprload->collectGarbage(false);
+    } else if (command == "status") {
+        hyprload::g_pHyprload->showUpdateStatus();
     } else if (command == "overlay") {
         hyprload::overlay::g_pOverlay->toggleDrawOverlay();
     } else {
@@ -66,6 +82,9 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
     PHANDLE = handle;
     hyprload::g_pHyprload = std::make_unique<hyprload::Hyprload>();
     hyprload::overlay::g_pOverlay = std::make_unique<hyprload::overlay::HyprloadOverlay>();
+    hyprload::pipeline::g_pExecutor = std::make_unique<hyprload::pipeline::Executor>();
+    hyprload::updates::g_pUpdateCache = std::make_unique<hyprload::updates::UpdateCache>();
+    hyprload::power::g_pPowerPolicy = std::make_unique<hyprload::power::PowerPolicy>();
 
     std::string home = getenv("HOME");
     std::string defaultPluginDir = home + std::string("/.local/share/hyprload/");
@@ -83,6 +102,68 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
         HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_pluginQuiet, SConfigValue{.intValue = 0});
     configWasCreated = configWasCreated &&
         HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_pluginDebug, SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_gcMaxSize, SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_splitDebugInfo,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_preflightCheck,
+                                    SConfigValue{.intValue = 1});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_streamingReload,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_networkJobs, SConfigValue{.intValue = 4});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_buildJobs, SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_xdgLayout, SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_sharedCache,
+                                    SConfigValue{.strValue = STRVAL_EMPTY});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_minimalHeaders,
+                                    SConfigValue{.intValue = 1});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_headersArchive,
+                                    SConfigValue{.strValue = STRVAL_EMPTY});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_updateCheckInterval,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_maintenanceInterval,
+                                    SConfigValue{.intValue = 24});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_maintenanceTimeLimit,
+                                    SConfigValue{.intValue = 120});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_deferBuildsOnBattery,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_deferBuildsAbove,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_limitBuildsAbove,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_unloadPowerHungry,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_buildAffinity,
+                                    SConfigValue{.strValue = "efficiency"});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_compressBinaries,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_hermeticBuilds,
+                                    SConfigValue{.intValue = 0});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_toolchain,
+                                    SConfigValue{.strValue = STRVAL_EMPTY});
+    configWasCreated = configWasCreated &&
+        HyprlandAPI::addConfigValue(PHANDLE, hyprload::c_pgoCollectionTime,
+                                    SConfigValue{.intValue = 1800});
 
     configWasCreated = configWasCreated &&
         HyprlandAPI::addConfigValue(PHANDLE, hyprload::overlay::c_overlayAnimationCurve,
@@ -132,7 +213,7 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 
     hyprload::g_pHyprload->loadPlugins();
 
-    hyprload::success("Plugins loaded!");
+    hyprload::g_pHyprload->collectGarbage(true);
 
     return {"hyprload", "Hyprland plugin manager", "Duckonaut", "1.0.0"};
 }
@@ -141,6 +222,8 @@ APICALL EXPORT void PLUGIN_EXIT() {
     hyprload::debug("Unloading plugin...");
 
     hyprload::g_pHyprload->cleanupPlugin();
+    // Joins the workers while the stages they run are still mapped
+    hyprload::pipeline::g_pExecutor = nullptr;
 
     hyprload::debug("Unloaded successfully!");
 }
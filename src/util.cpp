@@ -3,9 +3,17 @@
 #include "types.hpp"
 #include "globals.hpp"
 #include "util.hpp"
+#include "GitBackend.hpp"
+#include "SharedCache.hpp"
 
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -20,6 +28,44 @@ namespace hyprload {
         return std::filesystem::path(hyprloadRoot->strValue);
     }
 
+    std::filesystem::path getXdgPath(const char* variable, const std::string& fallback) {
+        const char* value = std::getenv(variable);
+
+        if (value && value[0] == '/') {
+            return std::filesystem::path(value) / "hyprload";
+        }
+
+        return std::filesystem::path(fallback) / "hyprload";
+    }
+
+    std::filesystem::path getRuntimePath() {
+        if (!isXdgLayout()) {
+            return getRootPath();
+        }
+
+        return getXdgPath("XDG_RUNTIME_DIR", "/run/user/" + std::to_string(getuid()));
+    }
+
+    std::filesystem::path getCacheRootPath() {
+        if (!isXdgLayout()) {
+            return getRootPath();
+        }
+
+        const char* home = std::getenv("HOME");
+
+        return getXdgPath("XDG_CACHE_HOME", std::string(home ? home : "/tmp") + "/.cache");
+    }
+
+    std::filesystem::path getStatePath() {
+        if (!isXdgLayout()) {
+            return getRootPath() / "state";
+        }
+
+        const char* home = std::getenv("HOME");
+
+        return getXdgPath("XDG_STATE_HOME", std::string(home ? home : "/tmp") + "/.local/state");
+    }
+
     std::optional<std::filesystem::path> getConfigHyprlandHeadersPath() {
         static SConfigValue* hyprloadHeaders =
             HyprlandAPI::getConfigValue(PHANDLE, c_hyprlandHeaders);
@@ -33,13 +79,50 @@ namespace hyprload {
         return std::filesystem::path(hyprloadHeaders->strValue);
     }
 
+    std::optional<std::filesystem::path> getSharedCachePath() {
+        static SConfigValue* sharedCache = HyprlandAPI::getConfigValue(PHANDLE, c_sharedCache);
+
+        if (sharedCache->strValue.empty() || sharedCache->strValue == STRVAL_EMPTY) {
+            return std::nullopt;
+        }
+
+        return std::filesystem::path(sharedCache->strValue);
+    }
+
+    std::optional<std::string> getHeadersArchiveTemplate() {
+        static SConfigValue* headersArchive =
+            HyprlandAPI::getConfigValue(PHANDLE, c_headersArchive);
+
+        if (headersArchive->strValue.empty() || headersArchive->strValue == STRVAL_EMPTY) {
+            return std::nullopt;
+        }
+
+        return headersArchive->strValue;
+    }
+
     std::filesystem::path getHyprlandHeadersPath() {
         std::optional<std::filesystem::path> path = getConfigHyprlandHeadersPath();
         if (path.has_value()) {
             return path.value();
         }
 
-        return getRootPath() / "hyprland";
+        std::optional<std::filesystem::path> sharedCache = getSharedCachePath();
+        std::optional<std::string> commit = getHyprlandCommit();
+
+        if (sharedCache.has_value() && commit.has_value()) {
+            return cache::getSharedHeadersPath(sharedCache.value(), commit.value());
+        }
+
+        // Archives are extracted fresh for every commit instead of checked out in place
+        if (getHeadersArchiveTemplate().has_value() && commit.has_value()) {
+            return getCachePath() / "headers" / commit.value();
+        }
+
+        return getDefaultHyprlandHeadersPath();
+    }
+
+    std::filesystem::path getDefaultHyprlandHeadersPath() {
+        return getCacheRootPath() / "hyprland";
     }
 
     std::filesystem::path getPluginsPath() {
@@ -50,6 +133,38 @@ namespace hyprload {
         return getPluginsPath() / "bin";
     }
 
+    std::filesystem::path getPluginDebugInfoPath() {
+        return getPluginsPath() / "debug";
+    }
+
+    std::filesystem::path getPluginProfilesPath() {
+        return getPluginsPath() / "profiles";
+    }
+
+    std::filesystem::path getPluginSourcesPath() {
+        return getCacheRootPath() / "plugins" / "src";
+    }
+
+    std::filesystem::path getSelfSourcePath() {
+        return getCacheRootPath() / "src";
+    }
+
+    std::filesystem::path getSessionsPath() {
+        if (!isXdgLayout()) {
+            return getPluginsPath();
+        }
+
+        return getRuntimePath() / "sessions";
+    }
+
+    std::filesystem::path getCachePath() {
+        return getCacheRootPath() / "cache";
+    }
+
+    std::filesystem::path getLocksPath() {
+        return getRuntimePath() / "locks";
+    }
+
     bool isQuiet() {
         static SConfigValue* hyprloadQuiet = HyprlandAPI::getConfigValue(PHANDLE, c_pluginQuiet);
 
@@ -62,6 +177,201 @@ namespace hyprload {
         return hyprloadDebug->intValue;
     }
 
+    usize getGcMaxSize() {
+        static SConfigValue* gcMaxSize = HyprlandAPI::getConfigValue(PHANDLE, c_gcMaxSize);
+
+        if (gcMaxSize->intValue <= 0) {
+            return 0;
+        }
+
+        return static_cast<usize>(gcMaxSize->intValue) * 1024 * 1024;
+    }
+
+    bool isSplitDebugInfo() {
+        static SConfigValue* splitDebugInfo =
+            HyprlandAPI::getConfigValue(PHANDLE, c_splitDebugInfo);
+
+        return splitDebugInfo->intValue;
+    }
+
+    bool isPreflightCheck() {
+        static SConfigValue* preflightCheck =
+            HyprlandAPI::getConfigValue(PHANDLE, c_preflightCheck);
+
+        return preflightCheck->intValue;
+    }
+
+    bool isStreamingReload() {
+        static SConfigValue* streamingReload =
+            HyprlandAPI::getConfigValue(PHANDLE, c_streamingReload);
+
+        return streamingReload->intValue;
+    }
+
+    bool isMinimalHeaders() {
+        static SConfigValue* minimalHeaders =
+            HyprlandAPI::getConfigValue(PHANDLE, c_minimalHeaders);
+
+        return minimalHeaders->intValue;
+    }
+
+    bool isXdgLayout() {
+        static SConfigValue* xdgLayout = HyprlandAPI::getConfigValue(PHANDLE, c_xdgLayout);
+
+        return xdgLayout->intValue;
+    }
+
+    usize getNetworkJobs() {
+        static SConfigValue* networkJobs = HyprlandAPI::getConfigValue(PHANDLE, c_networkJobs);
+
+        return std::max<i64>(1, networkJobs->intValue);
+    }
+
+    usize getBuildJobs() {
+        static SConfigValue* buildJobs = HyprlandAPI::getConfigValue(PHANDLE, c_buildJobs);
+
+        if (buildJobs->intValue <= 0) {
+            return std::max(1u, std::thread::hardware_concurrency() / 2);
+        }
+
+        return buildJobs->intValue;
+    }
+
+    usize getUpdateCheckInterval() {
+        static SConfigValue* updateCheckInterval =
+            HyprlandAPI::getConfigValue(PHANDLE, c_updateCheckInterval);
+
+        if (updateCheckInterval->intValue <= 0) {
+            return 0;
+        }
+
+        return static_cast<usize>(updateCheckInterval->intValue) * 60;
+    }
+
+    usize getMaintenanceInterval() {
+        static SConfigValue* maintenanceInterval =
+            HyprlandAPI::getConfigValue(PHANDLE, c_maintenanceInterval);
+
+        if (maintenanceInterval->intValue <= 0) {
+            return 0;
+        }
+
+        return static_cast<usize>(maintenanceInterval->intValue) * 60 * 60;
+    }
+
+    usize getMaintenanceTimeLimit() {
+        static SConfigValue* maintenanceTimeLimit =
+            HyprlandAPI::getConfigValue(PHANDLE, c_maintenanceTimeLimit);
+
+        return std::max<i64>(1, maintenanceTimeLimit->intValue);
+    }
+
+    bool isDeferBuildsOnBattery() {
+        static SConfigValue* deferBuildsOnBattery =
+            HyprlandAPI::getConfigValue(PHANDLE, c_deferBuildsOnBattery);
+
+        return deferBuildsOnBattery->intValue;
+    }
+
+    usize getDeferBuildsTemperature() {
+        static SConfigValue* deferBuildsAbove =
+            HyprlandAPI::getConfigValue(PHANDLE, c_deferBuildsAbove);
+
+        return std::max<i64>(0, deferBuildsAbove->intValue);
+    }
+
+    usize getLimitBuildsTemperature() {
+        static SConfigValue* limitBuildsAbove =
+            HyprlandAPI::getConfigValue(PHANDLE, c_limitBuildsAbove);
+
+        return std::max<i64>(0, limitBuildsAbove->intValue);
+    }
+
+    bool isUnloadPowerHungry() {
+        static SConfigValue* unloadPowerHungry =
+            HyprlandAPI::getConfigValue(PHANDLE, c_unloadPowerHungry);
+
+        return unloadPowerHungry->intValue;
+    }
+
+    std::string getBuildAffinity() {
+        static SConfigValue* buildAffinity = HyprlandAPI::getConfigValue(PHANDLE, c_buildAffinity);
+
+        return buildAffinity->strValue;
+    }
+
+    bool isCompressBinaries() {
+        static SConfigValue* compressBinaries =
+            HyprlandAPI::getConfigValue(PHANDLE, c_compressBinaries);
+
+        return compressBinaries->intValue;
+    }
+
+    bool isHermeticBuilds() {
+        static SConfigValue* hermeticBuilds = HyprlandAPI::getConfigValue(PHANDLE, c_hermeticBuilds);
+
+        return hermeticBuilds->intValue;
+    }
+
+    std::optional<std::string> getDefaultToolchain() {
+        static SConfigValue* toolchain = HyprlandAPI::getConfigValue(PHANDLE, c_toolchain);
+
+        if (toolchain->strValue.empty() || toolchain->strValue == STRVAL_EMPTY) {
+            return std::nullopt;
+        }
+
+        return toolchain->strValue;
+    }
+
+    usize getPgoCollectionTime() {
+        static SConfigValue* pgoCollectionTime =
+            HyprlandAPI::getConfigValue(PHANDLE, c_pgoCollectionTime);
+
+        return std::max<i64>(0, pgoCollectionTime->intValue);
+    }
+
+    std::optional<std::string> getHyprlandCommit() {
+        static std::mutex commitMutex;
+        static std::optional<std::string> commitHash = std::nullopt;
+
+        // Pipeline workers ask concurrently. A failed query is not cached, so the next caller
+        // retries it, which rules out std::call_once
+        auto lock = std::scoped_lock<std::mutex>(commitMutex);
+
+        if (commitHash.has_value()) {
+            return commitHash;
+        }
+
+        std::string hyprlandVersion = HyprlandAPI::invokeHyprctlCommand("version", {}, "j");
+        debug("Hyprland version: " + hyprlandVersion);
+
+        usize hyprlandVersionStart = hyprlandVersion.find("\"commit\": \"");
+        if (hyprlandVersionStart == std::string::npos) {
+            return std::nullopt;
+        }
+
+        commitHash = hyprlandVersion.substr(hyprlandVersionStart + 11, 40);
+
+        return commitHash;
+    }
+
+    std::optional<std::string> getHeadersCommit(const std::filesystem::path& hyprlandHeaders) {
+        std::ifstream archiveCommit = std::ifstream(hyprlandHeaders / c_archiveCommitFile);
+        std::string commit;
+
+        if (std::getline(archiveCommit, commit) && commit.size() == 40) {
+            return commit;
+        }
+
+        // A configured tree without git metadata may sit inside another repository, whose
+        // commit says nothing about the headers
+        if (!std::filesystem::exists(hyprlandHeaders / ".git")) {
+            return std::nullopt;
+        }
+
+        return git::getBackend().getHead(hyprlandHeaders);
+    }
+
     void info(const std::string& message, usize duration) {
         std::string logMessage = "[hyprload] " + message;
         if (!isQuiet()) {
@@ -164,6 +474,76 @@ namespace hyprload {
         flock(lock, LOCK_UN);
     }
 
+    FileLock::FileLock(const std::filesystem::path& lockFile, bool shared, bool wait) {
+        fd_t fd = open(lockFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+
+        if (fd < 0) {
+            debug("Failed to open lock " + lockFile.string());
+            return;
+        }
+
+        // Other users sharing the root lock it too. The umask is process-wide, and builds fork
+        // from other threads meanwhile, so the mode is widened on the file instead. This fails
+        // harmlessly on locks another user created
+        fchmod(fd, 0666);
+
+        int operation = (shared ? LOCK_SH : LOCK_EX) | (wait ? 0 : LOCK_NB);
+        int result = flock(fd, operation);
+
+        while (result < 0 && errno == EINTR) {
+            result = flock(fd, operation);
+        }
+
+        if (result < 0) {
+            close(fd);
+            return;
+        }
+
+        m_iFd = fd;
+    }
+
+    FileLock::~FileLock() {
+        if (m_iFd < 0) {
+            return;
+        }
+
+        flock(m_iFd, LOCK_UN);
+        close(m_iFd);
+    }
+
+    bool FileLock::isLocked() const {
+        return m_iFd >= 0;
+    }
+
+    std::filesystem::path getLockFile(const std::string& name) {
+        std::error_code ec;
+        std::filesystem::create_directories(getLocksPath(), ec);
+
+        return getLocksPath() / (name + ".lock");
+    }
+
+    std::filesystem::path getPathLockFile(const std::string& prefix,
+                                          const std::filesystem::path& path) {
+        std::filesystem::path normalized = path.lexically_normal();
+
+        return getLockFile(prefix + "." + normalized.filename().string() + "." +
+                           hashString(normalized.string()).substr(0, 8));
+    }
+
+    std::string hashString(const std::string& data) {
+        u64 hash = 0xcbf29ce484222325;
+
+        for (char c : data) {
+            hash ^= static_cast<u8>(c);
+            hash *= 0x100000001b3;
+        }
+
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+
+        return std::string(buffer);
+    }
+
     std::tuple<int, std::string> executeCommand(const std::string& command) {
         std::string result = "";
         FILE* pipe = popen(command.c_str(), "r");
@@ -182,4 +562,34 @@ namespace hyprload {
 
         return std::make_tuple(exit, result);
     }
+
+    usize getDiskUsage(const std::filesystem::path& path) {
+        std::error_code ec;
+
+        if (std::filesystem::is_symlink(path, ec)) {
+            return 0;
+        }
+
+        if (!std::filesystem::is_directory(path, ec)) {
+            usize fileSize = std::filesystem::file_size(path, ec);
+            return ec ? 0 : fileSize;
+        }
+
+        usize total = 0;
+
+        auto iterator = std::filesystem::recursive_directory_iterator(
+            path, std::filesystem::directory_options::skip_permission_denied, ec);
+
+        for (; !ec && iterator != std::filesystem::recursive_directory_iterator();
+             iterator.increment(ec)) {
+            if (iterator->is_regular_file(ec) && !iterator->is_symlink(ec)) {
+                usize fileSize = iterator->file_size(ec);
+                total += ec ? 0 : fileSize;
+            }
+
+            ec.clear();
+        }
+
+        return total;
+    }
 }